@@ -0,0 +1,70 @@
+# Compile one GLSL shader to SPIR-V through a content-addressed cache.
+#
+#   cmake -DGLSLC=<glslc> -DSOURCE=<shader> -DOUTPUT=<spv> -DCACHE_DIR=<dir> [-DDEFINES=A;B=1] -P compile_shader.cmake
+#
+# The cache key is a SHA256 over the glslc version, the defines, the shader stage (file extension)
+# and the contents of the shader and every file it includes. Paths are not part of the key, so the
+# same shader built from different checkouts or build directories shares one cache entry.
+
+# Defines are passed to glslc as -D options.
+set(define-args)
+foreach(define ${DEFINES})
+    list(APPEND define-args -D${define})
+endforeach()
+
+execute_process(
+    COMMAND ${GLSLC} --version
+    OUTPUT_VARIABLE glslc-version
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "failed to run ${GLSLC}")
+endif()
+
+# Include closure: glslc -M prints a make rule "<output>: <shader> <include> ...".
+execute_process(
+    COMMAND ${GLSLC} -M ${define-args} ${SOURCE}
+    OUTPUT_VARIABLE dependencies
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${errors}")
+endif()
+string(REGEX REPLACE "^[^:]*:" "" dependencies "${dependencies}")
+string(REPLACE "\\\n" " " dependencies "${dependencies}")
+string(STRIP "${dependencies}" dependencies)
+separate_arguments(dependencies UNIX_COMMAND "${dependencies}")
+
+get_filename_component(stage ${SOURCE} EXT)
+set(key-input "glslc: ${glslc-version}\ndefines: ${DEFINES}\nstage: ${stage}\n")
+foreach(dependency ${dependencies})
+    file(SHA256 ${dependency} dependency-hash)
+    string(APPEND key-input "${dependency-hash}\n")
+endforeach()
+string(SHA256 key "${key-input}")
+set(cached ${CACHE_DIR}/${key}.spv)
+
+if(EXISTS ${cached})
+    execute_process(COMMAND ${CMAKE_COMMAND} -E copy ${cached} ${OUTPUT} RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "failed to copy ${cached} to ${OUTPUT}")
+    endif()
+    return()
+endif()
+
+execute_process(
+    COMMAND ${GLSLC} ${define-args} -o ${OUTPUT} ${SOURCE}
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "failed to compile ${SOURCE}")
+endif()
+
+# Publish into the cache with a rename, so concurrent builds never see a partially written entry.
+file(MAKE_DIRECTORY ${CACHE_DIR})
+string(RANDOM LENGTH 8 suffix)
+set(staging ${cached}.${suffix}.tmp)
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy ${OUTPUT} ${staging} RESULT_VARIABLE result)
+if(result EQUAL 0)
+    file(RENAME ${staging} ${cached})
+else()
+    message(WARNING "failed to store ${SOURCE} in the shader cache ${CACHE_DIR}")
+endif()
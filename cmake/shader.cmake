@@ -1,7 +1,20 @@
-function(add_shader TARGET SHADER)
+# Find glslc shader compiler.
+find_program(GLSLC glslc)
+
+# Compiled SPIR-V is stored in a content-addressed cache shared by all build directories and targets
+# (see compile_shader.cmake). Point SHADER_CACHE_DIR (or the environment variable of the same name) at
+# a shared location to share it across machines, e.g. on CI.
+if(DEFINED ENV{SHADER_CACHE_DIR})
+    set(default-shader-cache-dir $ENV{SHADER_CACHE_DIR})
+else()
+    set(default-shader-cache-dir $ENV{HOME}/.cache/vulkan-examples/spirv)
+endif()
+set(SHADER_CACHE_DIR ${default-shader-cache-dir} CACHE PATH "Directory of the content-addressed SPIR-V cache")
+set(SHADER_DEFINES "" CACHE STRING "Preprocessor definitions passed to glslc for every shader (e.g. A;B=1)")
 
-	# Find glslc shader compiler.
-	find_program(GLSLC glslc)
+set(SHADER_CMAKE_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+function(add_shader TARGET SHADER)
 
 	# All shaders for a sample are found here.
 	set(current-shader-path ${CMAKE_CURRENT_SOURCE_DIR}/${SHADER})
@@ -12,13 +25,20 @@ function(add_shader TARGET SHADER)
     # message(STATUS "shader: ${current-shader-path}")
     # message(STATUS "shader: ${current-output-path}")
 
-	# Add a custom command to compile GLSL to SPIR-V.
+	# Add a custom command to compile GLSL to SPIR-V (through the shader cache).
 	get_filename_component(current-output-dir ${current-output-path} DIRECTORY)
 	file(MAKE_DIRECTORY ${current-output-dir})
+	string(REPLACE ";" "$<SEMICOLON>" shader-defines "${SHADER_DEFINES}")
 	add_custom_command(
 		OUTPUT ${current-output-path}
-		COMMAND ${GLSLC} -o ${current-output-path} ${current-shader-path}
-		DEPENDS ${current-shader-path}
+		COMMAND ${CMAKE_COMMAND}
+			-DGLSLC=${GLSLC}
+			-DSOURCE=${current-shader-path}
+			-DOUTPUT=${current-output-path}
+			-DCACHE_DIR=${SHADER_CACHE_DIR}
+			-DDEFINES=${shader-defines}
+			-P ${SHADER_CMAKE_DIR}/compile_shader.cmake
+		DEPENDS ${current-shader-path} ${SHADER_CMAKE_DIR}/compile_shader.cmake
 		IMPLICIT_DEPENDS CXX ${current-shader-path}
 		VERBATIM)
 
@@ -33,19 +53,23 @@ function(add_all_shader TARGET)
     file(GLOB fragment-shaders ${CMAKE_CURRENT_SOURCE_DIR}/*.frag)
     file(GLOB compute-shaders ${CMAKE_CURRENT_SOURCE_DIR}/*.comp)
 
-    # Add them to the build.
-    foreach(vertex-shader ${vertex-shaders})
-        get_filename_component(p ${vertex-shader} NAME)
+    # Add them to the build, and collect the outputs for the pack.
+    set(pack-inputs)
+    set(pack-dependencies)
+    foreach(shader ${vertex-shaders} ${fragment-shaders} ${compute-shaders})
+        get_filename_component(p ${shader} NAME)
         add_shader(${TARGET} ${p})
-    endforeach(vertex-shader)
+        list(APPEND pack-inputs ${p}=${CMAKE_CURRENT_BINARY_DIR}/${p}.spv)
+        list(APPEND pack-dependencies ${CMAKE_CURRENT_BINARY_DIR}/${p}.spv)
+    endforeach()
 
-    foreach(fragment-shader ${fragment-shaders})
-        get_filename_component(p ${fragment-shader} NAME)
-        add_shader(${TARGET} ${p})
-    endforeach(fragment-shader)
-
-    foreach(compute-shader ${compute-shaders})
-        get_filename_component(p ${compute-shader} NAME)
-        add_shader(${TARGET} ${p})
-    endforeach(compute-shader)
-endfunction(add_all_shader)
\ No newline at end of file
+    # Pack all SPIR-V of the target into a single archive (<target>.spvpack) for the runtime loader.
+    set(pack-path ${CMAKE_CURRENT_BINARY_DIR}/${TARGET}.spvpack)
+    add_custom_command(
+        OUTPUT ${pack-path}
+        COMMAND shader_pack ${pack-path} ${pack-inputs}
+        DEPENDS shader_pack ${pack-dependencies}
+        VERBATIM)
+    set_source_files_properties(${pack-path} PROPERTIES GENERATED TRUE)
+    target_sources(${TARGET} PRIVATE ${pack-path})
+endfunction(add_all_shader)
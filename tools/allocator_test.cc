@@ -0,0 +1,154 @@
+// FreeListAllocator 的主机端测试 (只做地址计算, 不需要 Vulkan 设备)
+//   用法: allocator_test, 全部通过时返回 0
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+#include "free_list_allocator.h"
+
+static int failures = 0;
+
+static void check(bool condition, const char* what, int line) {
+    if (!condition) {
+        std::cerr << "allocator_test.cc:" << line << ": check failed: " << what << std::endl;
+        failures++;
+    }
+}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+// 起始偏移按请求的对齐, 对齐产生的空隙仍然可以分配
+static void testAlignment() {
+    FreeListAllocator allocator(4096, 1);
+    uint64_t a, b, c;
+    CHECK(allocator.allocate(100, 1, AllocationKind::Linear, a));
+    CHECK(a == 0);
+    CHECK(allocator.allocate(64, 256, AllocationKind::Linear, b));
+    CHECK(b == 256);
+    CHECK(allocator.usedBytes() == 164);
+
+    // [100, 256) 是最小的能放下的空闲区间 (best fit)
+    CHECK(allocator.allocate(16, 16, AllocationKind::Linear, c));
+    CHECK(c == 112);
+    CHECK(c % 16 == 0);
+}
+
+// 不同 kind 的相邻分配不能共用一个 granularity 页, 相同 kind 可以
+static void testGranularity() {
+    FreeListAllocator allocator(4096, 1024);
+    uint64_t linear, optimal, linear2, optimal2;
+    CHECK(allocator.allocate(100, 16, AllocationKind::Linear, linear));
+    CHECK(linear == 0);
+    CHECK(allocator.allocate(100, 16, AllocationKind::Optimal, optimal));
+    CHECK(optimal == 1024);
+
+    // 同 kind 紧跟在后面, 只按请求的对齐
+    CHECK(allocator.allocate(100, 16, AllocationKind::Linear, linear2));
+    CHECK(linear2 == 112);
+    CHECK(allocator.allocate(100, 16, AllocationKind::Optimal, optimal2));
+    CHECK(optimal2 == 1136);
+
+    // 紧跟在 Optimal 后面的线性分配必须跳到下一页
+    FreeListAllocator after(4096, 256);
+    uint64_t image, buffer;
+    CHECK(after.allocate(100, 1, AllocationKind::Optimal, image));
+    CHECK(after.allocate(100, 1, AllocationKind::Linear, buffer));
+    CHECK(buffer == 256);
+
+    // 空闲区间后面的分配不能移动: 和它共页的不同 kind 分配只能放到别处
+    FreeListAllocator before(4096, 256);
+    uint64_t first, second, optimal3, linear3;
+    CHECK(before.allocate(100, 1, AllocationKind::Linear, first));
+    CHECK(before.allocate(100, 1, AllocationKind::Linear, second));
+    before.free(first);
+    CHECK(before.allocate(50, 1, AllocationKind::Optimal, optimal3));
+    CHECK(optimal3 == 256);
+    CHECK(before.allocate(50, 1, AllocationKind::Linear, linear3));
+    CHECK(linear3 == 200);  // 最小的能放下的空闲区间 [200, 256)
+
+    // 没有 granularity 限制时不同 kind 可以紧挨着
+    FreeListAllocator packed(4096, 1);
+    uint64_t packedLinear, packedOptimal;
+    CHECK(packed.allocate(100, 4, AllocationKind::Linear, packedLinear));
+    CHECK(packed.allocate(100, 4, AllocationKind::Optimal, packedOptimal));
+    CHECK(packedOptimal == 100);
+}
+
+// 释放时和前后相邻的空闲区间合并, 全部释放后回到一个完整的区间
+static void testCoalescing() {
+    FreeListAllocator allocator(1024, 1);
+    uint64_t a, b, c;
+    CHECK(allocator.allocate(256, 1, AllocationKind::Linear, a));
+    CHECK(allocator.allocate(256, 1, AllocationKind::Linear, b));
+    CHECK(allocator.allocate(256, 1, AllocationKind::Linear, c));
+    CHECK(allocator.freeRangeCount() == 1);
+
+    allocator.free(b);
+    CHECK(allocator.freeRangeCount() == 2);
+    allocator.free(a);  // 和后面 b 的空闲区间合并
+    CHECK(allocator.freeRangeCount() == 2);
+    CHECK(allocator.largestFreeRange() == 512);
+    allocator.free(c);  // 和前后两个空闲区间合并
+    CHECK(allocator.freeRangeCount() == 1);
+    CHECK(allocator.largestFreeRange() == 1024);
+    CHECK(allocator.empty());
+    CHECK(allocator.usedBytes() == 0);
+
+    // 对齐空隙也合并回去
+    uint64_t d, e;
+    CHECK(allocator.allocate(10, 1, AllocationKind::Linear, d));
+    CHECK(allocator.allocate(10, 512, AllocationKind::Linear, e));
+    CHECK(allocator.freeRangeCount() == 2);
+    allocator.free(d);
+    allocator.free(e);
+    CHECK(allocator.freeRangeCount() == 1);
+    CHECK(allocator.largestFreeRange() == 1024);
+}
+
+// 空间不足时返回 false; 空闲总量足够但没有足够大的连续区间时同样失败
+static void testOutOfSpace() {
+    FreeListAllocator allocator(1024, 1);
+    uint64_t offsets[4];
+    for (uint64_t& offset : offsets) {
+        CHECK(allocator.allocate(256, 1, AllocationKind::Linear, offset));
+    }
+    uint64_t extra;
+    CHECK(!allocator.allocate(1, 1, AllocationKind::Linear, extra));
+    CHECK(allocator.freeBytes() == 0);
+
+    allocator.free(offsets[0]);
+    allocator.free(offsets[2]);
+    CHECK(allocator.freeBytes() == 512);
+    CHECK(allocator.largestFreeRange() == 256);
+    CHECK(!allocator.allocate(512, 1, AllocationKind::Linear, extra));
+    CHECK(allocator.allocate(256, 1, AllocationKind::Linear, extra));
+
+    // 对齐后放不下也算空间不足
+    FreeListAllocator small(300, 1);
+    uint64_t first;
+    CHECK(small.allocate(10, 1, AllocationKind::Linear, first));
+    CHECK(!small.allocate(100, 256, AllocationKind::Linear, extra));
+
+    bool threw = false;
+    try {
+        allocator.free(3);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+int main() {
+    testAlignment();
+    testGranularity();
+    testCoalescing();
+    testOutOfSpace();
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "allocator_test: all checks passed" << std::endl;
+    return EXIT_SUCCESS;
+}
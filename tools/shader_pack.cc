@@ -0,0 +1,52 @@
+// 把若干个 .spv 文件打包成一个 .spvpack 文件 (格式见 triangle/shader_pack_format.h)
+//   用法: shader_pack <输出文件> <名字>=<.spv 文件> ...
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "shader_archive.h"
+
+static bool readFile(const std::string& path, std::vector<char>& data) {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    data.resize((size_t) file.tellg());
+    file.seekg(0);
+    file.read(data.data(), data.size());
+    return static_cast<bool>(file);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <output> <name>=<file.spv> ..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::pair<std::string, std::vector<char>>> inputs;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t separator = arg.find('=');
+        if (separator == std::string::npos || separator == 0) {
+            std::cerr << "invalid input (expected <name>=<file>): " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::vector<char> data;
+        if (!readFile(arg.substr(separator + 1), data)) {
+            std::cerr << "failed to read " << arg.substr(separator + 1) << std::endl;
+            return EXIT_FAILURE;
+        }
+        inputs.emplace_back(arg.substr(0, separator), std::move(data));
+    }
+
+    try {
+        writeShaderArchive(argv[1], std::move(inputs));
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,183 @@
+#include "compute_pass.h"
+
+#include <stdexcept>
+#include <utility>
+
+#include "pipeline_builder.h"
+
+static bool sameInterface(const ShaderReflection& a, const ShaderReflection& b) {
+    if (a.bindings.size() != b.bindings.size() || a.pushConstantSize != b.pushConstantSize) {
+        return false;
+    }
+    for (size_t i = 0; i < a.bindings.size(); i++) {
+        const ShaderBinding& x = a.bindings[i];
+        const ShaderBinding& y = b.bindings[i];
+        if (x.set != y.set || x.binding != y.binding || x.type != y.type || x.count != y.count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+ComputePass::ComputePass(VkDevice device, const ShaderCode& shader, VkPipelineCache cache, uint32_t dynamicBindings)
+    : device(device), cache(cache), dynamicBindings(dynamicBindings)
+{
+    interface = reflectShader(shader);
+    if (interface.stage != VK_SHADER_STAGE_COMPUTE_BIT) {
+        throw std::runtime_error("compute pass shader is not a compute shader");
+    }
+
+    for (const ShaderBinding& binding : interface.bindings) {
+        if (binding.set != 0) {
+            throw std::runtime_error("compute pass only supports descriptor set 0 (" + binding.name + " is in set " +
+                                     std::to_string(binding.set) + ")");
+        }
+        VkDescriptorSetLayoutBinding layoutBinding{};
+        layoutBinding.binding = binding.binding;
+        layoutBinding.descriptorType = binding.type;
+        if (binding.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && binding.binding < 32 && (dynamicBindings >> binding.binding & 1)) {
+            layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        }
+        layoutBinding.descriptorCount = binding.count;
+        layoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        layoutBindings.push_back(layoutBinding);
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
+    layoutInfo.pBindings = layoutBindings.data();
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute descriptor set layout!");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = interface.pushConstantSize;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = interface.pushConstantSize > 0 ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        throw std::runtime_error("failed to create compute pipeline layout!");
+    }
+
+    try {
+        computePipeline = createPipeline(shader);
+    } catch (...) {
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        throw;
+    }
+}
+
+ComputePass::~ComputePass() {
+    vkDestroyPipeline(device, computePipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+}
+
+VkPipeline ComputePass::createPipeline(const ShaderCode& shader) const {
+    VkShaderModule module = createShaderModule(device, shader.code, shader.size);
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = module;
+    pipelineInfo.stage.pName = interface.entryPoint.c_str();
+    pipelineInfo.layout = pipelineLayout;
+
+    VkPipeline pipeline;
+    VkResult result = vkCreateComputePipelines(device, cache, 1, &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(device, module, nullptr);  // 管线创建后着色器模块不再需要
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline!");
+    }
+    return pipeline;
+}
+
+VkPipeline ComputePass::reload(const ShaderCode& shader) {
+    ShaderReflection reloaded = reflectShader(shader);
+    if (reloaded.stage != VK_SHADER_STAGE_COMPUTE_BIT || !sameInterface(interface, reloaded)) {
+        throw std::runtime_error("reloaded compute shader changed its descriptor bindings or push constants");
+    }
+    // 入口点名和工作组大小可以改变, 先按新的入口点创建管线, 成功后再替换
+    ShaderReflection previous = interface;
+    interface = reloaded;
+    VkPipeline pipeline;
+    try {
+        pipeline = createPipeline(shader);
+    } catch (...) {
+        interface = previous;
+        throw;
+    }
+    std::swap(computePipeline, pipeline);
+    return pipeline;
+}
+
+std::vector<VkDescriptorPoolSize> ComputePass::poolSizes(uint32_t setCount) const {
+    std::vector<VkDescriptorPoolSize> sizes;
+    for (const VkDescriptorSetLayoutBinding& binding : layoutBindings) {
+        bool merged = false;
+        for (VkDescriptorPoolSize& size : sizes) {
+            if (size.type == binding.descriptorType) {
+                size.descriptorCount += binding.descriptorCount * setCount;
+                merged = true;
+            }
+        }
+        if (!merged) {
+            sizes.push_back({binding.descriptorType, binding.descriptorCount * setCount});
+        }
+    }
+    return sizes;
+}
+
+void ComputePass::writeBuffer(VkDescriptorSet set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) const {
+    for (const VkDescriptorSetLayoutBinding& layoutBinding : layoutBindings) {
+        if (layoutBinding.binding != binding) {
+            continue;
+        }
+        VkDescriptorType type = layoutBinding.descriptorType;
+        if (type != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && type != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC &&
+            type != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+            break;
+        }
+        VkDescriptorBufferInfo bufferInfo{buffer, offset, range};
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = set;
+        descriptorWrite.dstBinding = binding;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = type;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &bufferInfo;
+        vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+        return;
+    }
+    throw std::runtime_error("compute shader has no buffer at binding " + std::to_string(binding));
+}
+
+void ComputePass::bind(VkCommandBuffer commandBuffer, VkDescriptorSet set, uint32_t dynamicOffsetCount,
+                       const uint32_t* dynamicOffsets) const {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, dynamicOffsetCount, dynamicOffsets);
+}
+
+void ComputePass::pushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size) const {
+    if (size > interface.pushConstantSize) {
+        throw std::runtime_error("push constants larger than the shader's push constant block (" + std::to_string(size) + " > " +
+                                 std::to_string(interface.pushConstantSize) + " bytes)");
+    }
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, size, data);
+}
+
+void ComputePass::dispatch(VkCommandBuffer commandBuffer, uint32_t x, uint32_t y, uint32_t z) const {
+    vkCmdDispatch(commandBuffer, groupCount(x, 0), groupCount(y, 1), groupCount(z, 2));
+}
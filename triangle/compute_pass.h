@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "shader_archive.h"
+#include "shader_reflection.h"
+
+// 一个计算着色器的管线和它的接口。描述符集布局和 push constant 范围都从字节码反射得到 (见 shader_reflection.h),
+//   修改着色器的绑定不需要同时修改应用代码里的布局。只支持一个描述符集 (set 0)。
+//   用法: 按 poolSizes 创建描述符池并用 setLayout 分配描述符集, writeBuffer 写入缓冲;
+//   录制时 bind, pushConstants, 然后 dispatch 指定要覆盖的调用数 (按工作组大小向上取整成工作组数)。
+//   计算结果给其它阶段或队列使用时, 用 queue_ownership.h 的释放/获取屏障 (队列族相同时就是普通的屏障)。
+class ComputePass {
+public:
+    // dynamicBindings: 使用动态偏移的 uniform 缓冲的 binding 位掩码 (反射无法区分)。失败时抛出异常
+    ComputePass(VkDevice device, const ShaderCode& shader, VkPipelineCache cache, uint32_t dynamicBindings = 0);
+    ~ComputePass();
+
+    ComputePass(const ComputePass&) = delete;
+    ComputePass& operator=(const ComputePass&) = delete;
+
+    // 用新的字节码 (例如热重载) 重建管线。接口 (绑定、push constant 大小) 必须不变, 否则抛出异常并保留原来的管线。
+    //   返回被替换的管线, 已经提交的指令可能还在使用它, 由调用方在它们执行完后销毁
+    VkPipeline reload(const ShaderCode& shader);
+
+    const ShaderReflection& reflection() const { return interface; }
+    VkDescriptorSetLayout setLayout() const { return descriptorSetLayout; }
+    VkPipelineLayout layout() const { return pipelineLayout; }
+    VkPipeline pipeline() const { return computePipeline; }
+
+    // 分配 setCount 个描述符集需要的描述符数
+    std::vector<VkDescriptorPoolSize> poolSizes(uint32_t setCount) const;
+    // 写入缓冲类型的描述符, binding 不存在或者不是缓冲时抛出异常
+    void writeBuffer(VkDescriptorSet set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0,
+                     VkDeviceSize range = VK_WHOLE_SIZE) const;
+
+    // 覆盖 invocations 个调用需要的工作组数 (axis: 0/1/2 对应 x/y/z)
+    uint32_t groupCount(uint32_t invocations, uint32_t axis = 0) const {
+        return (invocations + interface.localSize[axis] - 1) / interface.localSize[axis];
+    }
+
+    void bind(VkCommandBuffer commandBuffer, VkDescriptorSet set, uint32_t dynamicOffsetCount = 0,
+              const uint32_t* dynamicOffsets = nullptr) const;
+    // size 超过着色器声明的 push constant 块时抛出异常
+    void pushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size) const;
+    // 调用数为 x * y * z, 不是工作组数
+    void dispatch(VkCommandBuffer commandBuffer, uint32_t x, uint32_t y = 1, uint32_t z = 1) const;
+
+private:
+    VkPipeline createPipeline(const ShaderCode& shader) const;
+
+    VkDevice device;
+    VkPipelineCache cache;
+    uint32_t dynamicBindings;
+    ShaderReflection interface;
+    std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline computePipeline = VK_NULL_HANDLE;
+};
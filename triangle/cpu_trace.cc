@@ -0,0 +1,180 @@
+#include "cpu_trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+struct TraceEvent {
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+// 一个线程的环形缓冲。只有所属线程写入 events 和 head; write 在记录停止后读取
+struct ThreadBuffer {
+    uint32_t threadId;
+    std::string threadName;
+    std::vector<TraceEvent> events;  // 容量为 2 的幂
+    uint64_t mask;
+    std::atomic<uint64_t> head{0};   // 已经写入的事件总数
+};
+
+struct GpuEvent {
+    std::string name;
+    uint64_t anchor;
+    double offsetUs;
+    double durationUs;
+};
+
+// 线程缓冲在注册后一直保留到进程结束, 线程退出后 write 仍然可以读取它的事件
+static std::mutex registryMutex;
+static std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+static std::vector<GpuEvent> gpuEvents;  // 和线程缓冲容量相同的环形缓冲, 写满后覆盖最旧的事件
+static uint64_t gpuEventHead = 0;       // 已经写入的 GPU 事件总数
+static uint64_t eventsPerThread = CpuTrace::DEFAULT_EVENTS_PER_THREAD;
+
+// 校准: 开始记录时的计时值和 steady_clock 时间
+static uint64_t startTicks = 0;
+static std::chrono::steady_clock::time_point startTime;
+
+static thread_local ThreadBuffer* tlsBuffer = nullptr;
+static thread_local std::string tlsThreadName;
+
+static ThreadBuffer* registerThread() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+    buffer->threadId = static_cast<uint32_t>(threadBuffers.size());
+    buffer->threadName = tlsThreadName.empty() ? "thread " + std::to_string(buffer->threadId) : tlsThreadName;
+    buffer->events.resize(eventsPerThread);
+    buffer->mask = eventsPerThread - 1;
+    tlsBuffer = buffer.get();
+    threadBuffers.push_back(std::move(buffer));
+    return tlsBuffer;
+}
+
+static void writeJsonString(std::ostream& out, const std::string& value) {
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << ' ';
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+void CpuTrace::start(uint32_t capacity) {
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        uint64_t rounded = 1;
+        while (rounded < std::max(capacity, 1u)) {
+            rounded <<= 1;
+        }
+        eventsPerThread = rounded;
+        gpuEvents.assign(eventsPerThread, GpuEvent{});
+        gpuEventHead = 0;
+        startTicks = now();
+        startTime = std::chrono::steady_clock::now();
+    }
+    active.store(true, std::memory_order_release);
+}
+
+void CpuTrace::record(const char* name, uint64_t begin, uint64_t end) {
+    ThreadBuffer* buffer = tlsBuffer;
+    if (!buffer) {
+        buffer = registerThread();
+    }
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    buffer->events[head & buffer->mask] = {name, begin, end};
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void CpuTrace::setThreadName(const std::string& name) {
+    tlsThreadName = name;
+    if (tlsBuffer) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        tlsBuffer->threadName = name;
+    }
+}
+
+void CpuTrace::addGpuEvent(const std::string& name, uint64_t anchor, double offsetUs, double durationUs) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (gpuEvents.empty()) {
+        return;
+    }
+    gpuEvents[gpuEventHead % gpuEvents.size()] = {name, anchor, offsetUs, durationUs};
+    gpuEventHead++;
+}
+
+uint64_t CpuTrace::write(const std::string& path, uint64_t* dropped) {
+    active.store(false, std::memory_order_release);
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    // 用开始和结束时的 steady_clock 把计时值换算成微秒 (steady_clock 的计时值本身就是纳秒)
+    uint64_t endTicks = now();
+    double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+    double usPerTick = endTicks > startTicks ? elapsedUs / static_cast<double>(endTicks - startTicks) : 0.0;
+    auto toUs = [&](uint64_t ticks) {
+        return ticks >= startTicks ? static_cast<double>(ticks - startTicks) * usPerTick : -static_cast<double>(startTicks - ticks) * usPerTick;
+    };
+
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("failed to open trace file " + path);
+    }
+    out.precision(3);
+    out << std::fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}},\n"
+        << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GPU\"}}";
+
+    uint64_t written = 0;
+    uint64_t lost = 0;
+    for (const auto& buffer : threadBuffers) {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":";
+        writeJsonString(out, buffer->threadName);
+        out << "}}";
+
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = head > buffer->events.size() ? head - buffer->events.size() : 0;
+        lost += first;
+        for (uint64_t i = first; i < head; i++) {
+            const TraceEvent& event = buffer->events[i & buffer->mask];
+            out << ",\n{\"name\":";
+            writeJsonString(out, event.name);
+            out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->threadId << ",\"ts\":" << toUs(event.begin)
+                << ",\"dur\":" << static_cast<double>(event.end - event.begin) * usPerTick << "}";
+            written++;
+        }
+        buffer->head.store(0, std::memory_order_relaxed);
+    }
+
+    if (gpuEventHead > 0) {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"graphics queue\"}}";
+    }
+    uint64_t firstGpuEvent = gpuEventHead > gpuEvents.size() ? gpuEventHead - gpuEvents.size() : 0;
+    lost += firstGpuEvent;
+    for (uint64_t i = firstGpuEvent; i < gpuEventHead; i++) {
+        const GpuEvent& event = gpuEvents[i % gpuEvents.size()];
+        out << ",\n{\"name\":";
+        writeJsonString(out, event.name);
+        out << ",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":" << toUs(event.anchor) + event.offsetUs << ",\"dur\":" << event.durationUs << "}";
+        written++;
+    }
+    gpuEventHead = 0;
+
+    out << "\n]}\n";
+    if (!out) {
+        throw std::runtime_error("failed to write trace file " + path);
+    }
+    if (dropped) {
+        *dropped = lost;
+    }
+    return written;
+}
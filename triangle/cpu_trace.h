@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "config.h"
+
+// CPU 帧时间线: 记录代码范围的开始和结束时间, 导出为 Chrome trace JSON (chrome://tracing 或 https://ui.perfetto.dev 打开)。
+//   每个线程把事件写入自己的环形缓冲 (只有所属线程写入, 不加锁), 缓冲写满后覆盖最旧的事件。
+//   时间戳在 x86 上用 rdtsc 读取, 导出时按 steady_clock 校准成微秒; 其它平台直接使用 steady_clock。
+//
+//   代码中用 TRACE_SCOPE("名字") 标记一个范围 (名字必须是字符串字面量, 只保存指针)。没有调用 CpuTrace::start 时
+//   每个范围只检查一次开关; 构建时关闭 ENABLE_CPU_TRACE 则这些宏展开为空, 没有任何开销。
+#if ENABLE_CPU_TRACE
+#define CPU_TRACE_CONCAT_INNER(a, b) a##b
+#define CPU_TRACE_CONCAT(a, b) CPU_TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) CpuTraceScope CPU_TRACE_CONCAT(cpuTraceScope, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) CpuTrace::setThreadName(name)
+#else
+#define TRACE_SCOPE(name) ((void) 0)
+#define TRACE_THREAD_NAME(name) ((void) 0)
+#endif
+
+class CpuTrace {
+public:
+    static const uint32_t DEFAULT_EVENTS_PER_THREAD = 1 << 16;
+
+    // 开始记录。eventsPerThread 向上取整为 2 的幂, 之后第一次记录事件的线程按这个容量分配缓冲
+    static void start(uint32_t eventsPerThread = DEFAULT_EVENTS_PER_THREAD);
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+
+    // 当前时间 (时间线内部的计时单位, 只能用于 record 和 addGpuEvent)
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // 记录当前线程的一个范围
+    static void record(const char* name, uint64_t begin, uint64_t end);
+    // 设置当前线程在时间线中显示的名字
+    static void setThreadName(const std::string& name);
+
+    // 记录一个 GPU 范围, 显示在单独的 GPU 轨道上。GPU 时间戳和 CPU 时钟没有共同的基准, 所以 GPU 事件以 CPU 上的一个
+    //   锚点 (例如提交这一帧的时间) 为起点, offsetUs 是相对锚点的偏移。每帧只调用几次, 加锁保护;
+    //   和线程缓冲一样保存在同样容量的环形缓冲中, 写满后覆盖最旧的事件
+    static void addGpuEvent(const std::string& name, uint64_t anchor, double offsetUs, double durationUs);
+
+    // 停止记录并写出 Chrome trace JSON 文件, 返回写出的事件数。调用时其它线程不应再记录事件。失败时抛出异常
+    static uint64_t write(const std::string& path, uint64_t* dropped = nullptr);
+
+private:
+    static inline std::atomic<bool> active{false};
+};
+
+// 记录所在作用域的范围 (由 TRACE_SCOPE 宏使用)
+class CpuTraceScope {
+public:
+    explicit CpuTraceScope(const char* name) : name(name), begin(CpuTrace::enabled() ? CpuTrace::now() : 0) {}
+    ~CpuTraceScope() {
+        if (begin != 0) {
+            CpuTrace::record(name, begin, CpuTrace::now());
+        }
+    }
+
+    CpuTraceScope(const CpuTraceScope&) = delete;
+    CpuTraceScope& operator=(const CpuTraceScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t begin;
+};
@@ -0,0 +1,68 @@
+#include "frame_arena.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+FrameArena::FrameArena(GpuAllocator& allocator, VkDeviceSize bytesPerFrame, uint32_t frameCount, VkDeviceSize alignment,
+                       VkDeviceSize persistentBytes)
+    : allocator(allocator), frameCount(frameCount), alignment(std::max<VkDeviceSize>(alignment, 1))
+{
+    // 每个区域的起始位置也需要对齐
+    frameSize = alignUp(bytesPerFrame, this->alignment);
+    persistentBegin = frameSize * frameCount;
+    persistentHead = persistentBegin;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferSize = persistentBegin + alignUp(persistentBytes, this->alignment);
+    bufferInfo.size = bufferSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    // 优先使用 CPU 可以直接写入的显存 (resizable BAR), 没有时使用普通的主机内存
+    try {
+        allocator.createBuffer(bufferInfo,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            arenaBuffer, allocation);
+    } catch (const std::runtime_error&) {
+        allocator.createBuffer(bufferInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            arenaBuffer, allocation);
+    }
+}
+
+FrameArena::~FrameArena() {
+    allocator.destroyBuffer(arenaBuffer, allocation);
+}
+
+void FrameArena::beginFrame(uint32_t frame) {
+    currentFrame = frame % frameCount;
+    head = frameSize * currentFrame;
+}
+
+void* FrameArena::bump(VkDeviceSize& head, VkDeviceSize begin, VkDeviceSize end, VkDeviceSize size, uint32_t& offset) {
+    VkDeviceSize allocationEnd = head + size;
+    if (allocationEnd > end) {
+        throw std::runtime_error("frame arena exhausted: " + std::to_string(allocationEnd - begin) + " bytes requested, "
+                                 + std::to_string(end - begin) + " available");
+    }
+
+    offset = static_cast<uint32_t>(head);
+    head = std::min(alignUp(allocationEnd, alignment), end);
+    return static_cast<char*>(allocation.mapped) + offset;
+}
+
+void* FrameArena::allocate(VkDeviceSize size, uint32_t& offset) {
+    VkDeviceSize begin = frameSize * currentFrame;
+    void* data = bump(head, begin, begin + frameSize, size, offset);
+    peak = std::max(peak, head - begin);
+    return data;
+}
+
+void* FrameArena::allocatePersistent(VkDeviceSize size, uint32_t& offset) {
+    return bump(persistentHead, persistentBegin, bufferSize, size, offset);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+#include "gpu_allocator.h"
+
+// 每帧的线性 (bump) 分配器, 用于只在一帧内有效的 uniform 数据。
+//   整个分配器只有一个持久映射的主机可见缓冲, 按 in-flight 帧分成若干个区域。录制某一帧时从该帧的区域顺序分配,
+//   得到的偏移作为动态 uniform 缓冲的偏移 (vkCmdBindDescriptorSets 的 pDynamicOffsets) 使用, 所以所有分配共用一个描述符集。
+//   该帧的提交执行完毕后 GPU 不再读取这个区域, 调用 beginFrame 整体重置, 不需要逐个释放。
+//   缓冲末尾可以额外保留一个永不重置的区域, 给预先录制的指令缓冲 (静态场景) 使用。
+class FrameArena {
+public:
+    // bytesPerFrame: 每帧区域的大小; alignment: 每次分配的对齐 (至少为 minUniformBufferOffsetAlignment)
+    FrameArena(GpuAllocator& allocator, VkDeviceSize bytesPerFrame, uint32_t frameCount, VkDeviceSize alignment,
+               VkDeviceSize persistentBytes = 0);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // 开始使用 frame 的区域 (调用前必须确认 GPU 已经执行完上一次使用该区域的指令)
+    void beginFrame(uint32_t frame);
+
+    // 从当前帧的区域分配 size 字节, 返回映射地址, offset 为在缓冲中的偏移。区域用完时抛出异常
+    void* allocate(VkDeviceSize size, uint32_t& offset);
+    // 从永不重置的区域分配
+    void* allocatePersistent(VkDeviceSize size, uint32_t& offset);
+
+    template <typename T>
+    T* allocate(uint32_t& offset) { return static_cast<T*>(allocate(sizeof(T), offset)); }
+    template <typename T>
+    T* allocatePersistent(uint32_t& offset) { return static_cast<T*>(allocatePersistent(sizeof(T), offset)); }
+
+    VkBuffer buffer() const { return arenaBuffer; }
+    VkDeviceSize bytesPerFrame() const { return frameSize; }
+    VkDeviceSize peakBytes() const { return peak; }  // 单帧用量的峰值
+
+private:
+    void* bump(VkDeviceSize& head, VkDeviceSize begin, VkDeviceSize end, VkDeviceSize size, uint32_t& offset);
+
+    GpuAllocator& allocator;
+    VkBuffer arenaBuffer = VK_NULL_HANDLE;
+    GpuAllocation allocation;
+
+    VkDeviceSize bufferSize;
+    VkDeviceSize frameSize;
+    uint32_t frameCount;
+    VkDeviceSize alignment;
+    VkDeviceSize persistentBegin;
+    VkDeviceSize persistentHead;
+
+    uint32_t currentFrame = 0;
+    VkDeviceSize head = 0;  // 当前帧区域内下一次分配的偏移 (相对于整个缓冲)
+    VkDeviceSize peak = 0;
+};
@@ -0,0 +1,121 @@
+#include "frame_encoder.h"
+
+#include <cstdio>
+#include <iostream>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+// jpg 编码质量 (1-100)
+static const int JPG_QUALITY = 90;
+
+bool parseFrameFormat(const std::string& name, FrameFormat& format) {
+    if (name == "png") {
+        format = FrameFormat::Png;
+    } else if (name == "jpg" || name == "jpeg") {
+        format = FrameFormat::Jpg;
+    } else if (name == "raw") {
+        format = FrameFormat::Raw;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+FrameEncoder::FrameEncoder(const std::string& outputDir, FrameFormat format, uint32_t threadCount)
+    : outputDir(outputDir), format(format)
+{
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+    for (uint32_t i = 0; i < threadCount; i++) {
+        workers.emplace_back(&FrameEncoder::workerLoop, this);
+    }
+}
+
+FrameEncoder::~FrameEncoder() {
+    finish();
+}
+
+void FrameEncoder::submit(const void* pixels, uint32_t width, uint32_t height, uint64_t frameIndex, ReleaseCallback release) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back({pixels, width, height, frameIndex, std::move(release)});
+    }
+    jobAvailable.notify_one();
+}
+
+void FrameEncoder::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void FrameEncoder::workerLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;  // stopping 且队列已清空
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        if (encode(job)) {
+            encoded++;
+        } else {
+            failed++;
+        }
+
+        if (job.release) {
+            job.release();
+        }
+    }
+}
+
+bool FrameEncoder::encode(const Job& job) {
+    char name[64];
+    const char* ext = format == FrameFormat::Png ? "png" : (format == FrameFormat::Jpg ? "jpg" : "rgba");
+    snprintf(name, sizeof(name), "/frame_%06llu.%s", (unsigned long long) job.frameIndex, ext);
+    std::string path = outputDir + name;
+
+    int w = static_cast<int>(job.width);
+    int h = static_cast<int>(job.height);
+    int ok = 0;
+
+    switch (format) {
+    case FrameFormat::Png:
+        ok = stbi_write_png(path.c_str(), w, h, 4, job.pixels, w * 4);
+        break;
+    case FrameFormat::Jpg:
+        ok = stbi_write_jpg(path.c_str(), w, h, 4, job.pixels, JPG_QUALITY);
+        break;
+    case FrameFormat::Raw: {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (file != nullptr) {
+            size_t size = static_cast<size_t>(job.width) * job.height * 4;
+            ok = fwrite(job.pixels, 1, size, file) == size;
+            ok = (fclose(file) == 0) && ok;
+        }
+        break;
+    }
+    }
+
+    if (!ok) {
+        std::cerr << "frame encoder: failed to write " << path << std::endl;
+    }
+    return ok != 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 帧数据保存格式
+enum class FrameFormat {
+    Png,
+    Jpg,
+    Raw,  // 不编码, 直接保存 RGBA8 像素数据
+};
+
+// 解析格式名 (png/jpg/raw), 不支持的格式返回 false
+bool parseFrameFormat(const std::string& name, FrameFormat& format);
+
+// 后台编码线程: 把回读到主机内存的帧编码后写入磁盘。
+//   渲染线程调用 submit 只是把任务放入队列, 不会等待编码完成; 编码完成后调用任务的 release 回调, 通知像素数据所在的缓冲可以复用。
+class FrameEncoder {
+public:
+    using ReleaseCallback = std::function<void()>;
+
+    FrameEncoder(const std::string& outputDir, FrameFormat format, uint32_t threadCount = 1);
+    ~FrameEncoder();
+
+    FrameEncoder(const FrameEncoder&) = delete;
+    FrameEncoder& operator=(const FrameEncoder&) = delete;
+
+    // 提交一帧 RGBA8 像素数据, pixels 在 release 被调用之前必须保持有效
+    void submit(const void* pixels, uint32_t width, uint32_t height, uint64_t frameIndex, ReleaseCallback release);
+
+    // 等待队列中所有任务完成并结束编码线程
+    void finish();
+
+    uint64_t encodedFrames() const { return encoded.load(); }
+    uint64_t failedFrames() const { return failed.load(); }
+
+private:
+    struct Job {
+        const void* pixels;
+        uint32_t width;
+        uint32_t height;
+        uint64_t frameIndex;
+        ReleaseCallback release;
+    };
+
+    void workerLoop();
+    bool encode(const Job& job);
+
+    std::string outputDir;
+    FrameFormat format;
+
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::deque<Job> jobs;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    std::atomic<uint64_t> encoded{0};
+    std::atomic<uint64_t> failed{0};
+};
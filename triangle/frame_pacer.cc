@@ -0,0 +1,189 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+// 睡眠到距离目标时间还有这么久时改为自旋, 吸收睡眠的唤醒误差
+static const std::chrono::microseconds SPIN_MARGIN(1000);
+
+bool parsePresentMode(const std::string& name, VkPresentModeKHR& mode) {
+    if (name == "immediate") {
+        mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    } else if (name == "mailbox") {
+        mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    } else if (name == "fifo") {
+        mode = VK_PRESENT_MODE_FIFO_KHR;
+    } else if (name == "fifo_relaxed") {
+        mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* presentModeName(VkPresentModeKHR mode) {
+    switch (mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo_relaxed";
+    default: return "other";
+    }
+}
+
+bool parseLatencyPolicy(const std::string& name, LatencyPolicy& policy) {
+    if (name == "low_latency") {
+        policy = LatencyPolicy::LowLatency;
+    } else if (name == "balanced") {
+        policy = LatencyPolicy::Balanced;
+    } else if (name == "max_throughput") {
+        policy = LatencyPolicy::MaxThroughput;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* latencyPolicyName(LatencyPolicy policy) {
+    switch (policy) {
+    case LatencyPolicy::LowLatency: return "low_latency";
+    case LatencyPolicy::Balanced: return "balanced";
+    case LatencyPolicy::MaxThroughput: return "max_throughput";
+    }
+    return "unknown";
+}
+
+LatencyPolicySettings latencyPolicySettings(LatencyPolicy policy) {
+    switch (policy) {
+    case LatencyPolicy::LowLatency: return {0, 1};
+    case LatencyPolicy::Balanced: return {1, 2};
+    case LatencyPolicy::MaxThroughput: return {2, 3};
+    }
+    return {1, 2};
+}
+
+FramePacer::FramePacer(uint32_t targetFps) {
+    setTargetFps(targetFps);
+}
+
+void FramePacer::setTargetFps(uint32_t targetFps) {
+    fps = targetFps;
+    period = fps > 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps)) : Clock::duration(0);
+    started = false;
+}
+
+void FramePacer::waitForNextFrame() {
+    if (fps == 0) {
+        return;
+    }
+    Clock::time_point now = Clock::now();
+    if (!started || now - nextFrame > period) {
+        nextFrame = now;
+        started = true;
+    } else {
+        if (nextFrame - now > SPIN_MARGIN) {
+            std::this_thread::sleep_until(nextFrame - SPIN_MARGIN);
+        }
+        while (Clock::now() < nextFrame) {
+        }
+    }
+    nextFrame += period;
+}
+
+// 写入环形缓冲, 写满之前逐个追加
+static void addSample(std::vector<double>& samples, uint64_t& count, double value) {
+    if (samples.size() < FramePacer::MAX_SAMPLES) {
+        samples.push_back(value);
+    } else {
+        samples[count % FramePacer::MAX_SAMPLES] = value;
+    }
+    count++;
+}
+
+void FramePacer::framePresented(Clock::time_point inputTime) {
+    Clock::time_point now = Clock::now();
+    if (hasLastPresent) {
+        addSample(frameMs, frameSamples, std::chrono::duration<double, std::milli>(now - lastPresent).count());
+    }
+    addSample(latencyMs, latencySamples, std::chrono::duration<double, std::milli>(now - inputTime).count());
+    lastPresent = now;
+    hasLastPresent = true;
+}
+
+void FramePacer::reset() {
+    frameMs.clear();
+    latencyMs.clear();
+    frameSamples = 0;
+    latencySamples = 0;
+    hasLastPresent = false;
+    started = false;
+}
+
+// 已排序数组的百分位数 (最近秩)
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(index, 1)) - 1];
+}
+
+FramePacingStats FramePacer::stats() const {
+    FramePacingStats result;
+    result.frames = frameMs.size();
+    if (!frameMs.empty()) {
+        std::vector<double> sorted = frameMs;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (double ms : sorted) {
+            total += ms;
+        }
+        result.meanMs = total / sorted.size();
+        double variance = 0.0;
+        for (double ms : sorted) {
+            variance += (ms - result.meanMs) * (ms - result.meanMs);
+        }
+        result.jitterMs = std::sqrt(variance / sorted.size());
+        result.p50Ms = percentile(sorted, 0.50);
+        result.p90Ms = percentile(sorted, 0.90);
+        result.p99Ms = percentile(sorted, 0.99);
+        result.maxMs = sorted.back();
+        if (fps > 0) {
+            double missThreshold = 1.5 * 1000.0 / fps;
+            result.missedFrames = sorted.end() - std::upper_bound(sorted.begin(), sorted.end(), missThreshold);
+        }
+    }
+    if (!latencyMs.empty()) {
+        std::vector<double> sorted = latencyMs;
+        std::sort(sorted.begin(), sorted.end());
+        result.latencyP50Ms = percentile(sorted, 0.50);
+        result.latencyP99Ms = percentile(sorted, 0.99);
+    }
+    return result;
+}
+
+void appendFramePacingCsv(const std::string& path, const std::string& presentMode, uint32_t swapChainImages, uint32_t targetFps,
+                          const FramePacingStats& stats) {
+    bool empty;
+    {
+        std::ifstream existing(path, std::ios::ate | std::ios::binary);
+        empty = !existing.is_open() || existing.tellg() == 0;
+    }
+    std::ofstream file(path, std::ios::app);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open " + path);
+    }
+    if (empty) {
+        file << "present_mode,swapchain_images,target_fps,frames,mean_ms,p50_ms,p90_ms,p99_ms,max_ms,jitter_ms,missed_frames,"
+                "latency_p50_ms,latency_p99_ms\n";
+    }
+    file << presentMode << "," << swapChainImages << "," << targetFps << "," << stats.frames << "," << stats.meanMs << ","
+         << stats.p50Ms << "," << stats.p90Ms << "," << stats.p99Ms << "," << stats.maxMs << "," << stats.jitterMs << ","
+         << stats.missedFrames << "," << stats.latencyP50Ms << "," << stats.latencyP99Ms << "\n";
+    if (!file) {
+        throw std::runtime_error("failed to write " + path);
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 解析呈现模式名 (immediate/mailbox/fifo/fifo_relaxed), 不支持的名字返回 false
+bool parsePresentMode(const std::string& name, VkPresentModeKHR& mode);
+const char* presentModeName(VkPresentModeKHR mode);
+
+// 延迟策略: 同时决定交换链图像数和 in-flight 帧数。
+//   CPU 在记录第 N+1 帧的指令时, GPU 可以同时执行第 N 帧, 避免两者互相等待; 但 in-flight 帧和排队的交换链图像越多,
+//   CPU 领先显示的帧就越多, 输入到显示的延迟也越大。
+enum class LatencyPolicy {
+    LowLatency,     // 最少的交换链图像, 1 帧 in-flight: CPU 和 GPU 串行, 延迟最低
+    Balanced,       // 最小图像数 + 1, 2 帧 in-flight (默认)
+    MaxThroughput,  // 最小图像数 + 2, 3 帧 in-flight: CPU 或 GPU 偶尔变慢时不会掉帧, 延迟最高
+};
+
+struct LatencyPolicySettings {
+    uint32_t extraSwapChainImages;  // 在表面要求的最小图像数之外额外请求的图像数
+    uint32_t framesInFlight;
+};
+
+// 解析策略名 (low_latency/balanced/max_throughput), 不支持的名字返回 false
+bool parseLatencyPolicy(const std::string& name, LatencyPolicy& policy);
+const char* latencyPolicyName(LatencyPolicy policy);
+LatencyPolicySettings latencyPolicySettings(LatencyPolicy policy);
+
+// 一次运行的帧节奏统计 (毫秒), 按最近 FramePacer::MAX_SAMPLES 帧计算
+struct FramePacingStats {
+    uint64_t frames = 0;
+    double meanMs = 0.0;
+    double p50Ms = 0.0;
+    double p90Ms = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+    double jitterMs = 0.0;      // 帧间隔的标准差
+    uint64_t missedFrames = 0;  // 间隔超过目标帧间隔 1.5 倍的帧数 (没有目标帧率时为 0)
+    double latencyP50Ms = 0.0;  // 输入到呈现的延迟
+    double latencyP99Ms = 0.0;
+};
+
+// 帧节奏: 按目标帧率在 CPU 上限制帧的开始时间, 并统计帧间隔和输入到呈现的延迟。
+//   每帧: waitForNextFrame (限速) -> 采样输入 (记录时间) -> 绘制和呈现 -> framePresented(输入采样时间)。
+//   限速放在输入采样之前, 这样等待的时间不会计入延迟。
+//
+//   延迟是从采样输入到 vkQueuePresentKHR 返回的时间。没有 VK_GOOGLE_display_timing 之类的扩展时拿不到图像真正显示的时间,
+//   所以这是一个下限: 不包括呈现引擎排队和扫描输出的时间 (FIFO 下每多排队一张图像就多一个刷新周期)。
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // 保留的样本数: 更早的样本被覆盖, 一直运行时内存不会增长 (60 fps 下约 18 分钟)
+    static const size_t MAX_SAMPLES = 1 << 16;
+
+    // targetFps 为 0 时不限速, 只统计
+    explicit FramePacer(uint32_t targetFps = 0);
+
+    void setTargetFps(uint32_t targetFps);
+    uint32_t targetFps() const { return fps; }
+
+    // 等待到下一帧的开始时间。先睡眠, 最后不到 1ms 自旋等待, 睡眠的唤醒误差不会推迟帧的开始。
+    //   落后超过一帧时不追赶, 从现在重新计时 (避免连续多帧不等待)
+    void waitForNextFrame();
+
+    // 一帧已经呈现 (无窗口模式下是已经提交), inputTime 是这一帧采样输入的时间
+    void framePresented(Clock::time_point inputTime);
+
+    // 清空统计 (例如切换呈现模式后重新测量)
+    void reset();
+
+    FramePacingStats stats() const;
+
+private:
+    uint32_t fps = 0;
+    Clock::duration period{0};
+    Clock::time_point nextFrame;
+    bool started = false;
+
+    Clock::time_point lastPresent;
+    bool hasLastPresent = false;
+    // 环形缓冲, 统计与样本顺序无关, 所以只记录写入的总数
+    std::vector<double> frameMs;    // 相邻两帧呈现的间隔
+    std::vector<double> latencyMs;
+    uint64_t frameSamples = 0;
+    uint64_t latencySamples = 0;
+};
+
+// 把一次运行的统计追加到 CSV 文件 (文件为空时先写表头), 多次运行的结果可以直接放在一起比较。失败时抛出异常
+void appendFramePacingCsv(const std::string& path, const std::string& presentMode, uint32_t swapChainImages, uint32_t targetFps,
+                          const FramePacingStats& stats);
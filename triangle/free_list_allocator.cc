@@ -0,0 +1,129 @@
+#include "free_list_allocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    if (alignment <= 1) {
+        return value;
+    }
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+FreeListAllocator::FreeListAllocator(uint64_t size, uint64_t granularity)
+    : totalSize(size), granularity(std::max<uint64_t>(granularity, 1))
+{
+    if (size > 0) {
+        freeRanges[0] = size;
+    }
+}
+
+// endOfFirst 是前一个分配的结束位置 (不包含), startOfSecond 是后一个分配的起始位置
+bool FreeListAllocator::onSamePage(uint64_t endOfFirst, uint64_t startOfSecond) const {
+    if (granularity <= 1 || endOfFirst == 0) {
+        return false;
+    }
+    uint64_t pageMask = ~(granularity - 1);  // bufferImageGranularity 一定是 2 的幂
+    return ((endOfFirst - 1) & pageMask) == (startOfSecond & pageMask);
+}
+
+bool FreeListAllocator::allocate(uint64_t size, uint64_t alignment, AllocationKind kind, uint64_t& offset) {
+    size = std::max<uint64_t>(size, 1);
+
+    auto best = freeRanges.end();
+    uint64_t bestOffset = 0;
+
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        uint64_t rangeBegin = it->first;
+        uint64_t rangeEnd = it->first + it->second;
+        if (it->second < size || (best != freeRanges.end() && it->second >= best->second)) {
+            continue;
+        }
+
+        uint64_t candidate = alignUp(rangeBegin, alignment);
+
+        // 空闲区间前面紧挨着的分配 (相邻的空闲区间总是被合并, 所以前一个区间一定是分配或者不存在)
+        auto prev = allocations.lower_bound(rangeBegin);
+        if (prev != allocations.begin()) {
+            --prev;
+            uint64_t prevEnd = prev->first + prev->second.size;
+            if (prev->second.kind != kind && onSamePage(prevEnd, candidate)) {
+                candidate = alignUp(candidate, granularity);
+            }
+        }
+
+        uint64_t candidateEnd = candidate + size;
+        if (candidateEnd > rangeEnd) {
+            continue;
+        }
+
+        // 后面紧挨着的分配不能移动, 和它冲突时这个空闲区间不可用
+        auto next = allocations.find(rangeEnd);
+        if (next != allocations.end() && next->second.kind != kind && onSamePage(candidateEnd, next->first)) {
+            continue;
+        }
+
+        best = it;
+        bestOffset = candidate;
+    }
+
+    if (best == freeRanges.end()) {
+        return false;
+    }
+
+    uint64_t rangeBegin = best->first;
+    uint64_t rangeEnd = best->first + best->second;
+    freeRanges.erase(best);
+
+    // 对齐产生的空隙和剩余部分仍然是空闲区间
+    if (bestOffset > rangeBegin) {
+        freeRanges[rangeBegin] = bestOffset - rangeBegin;
+    }
+    if (bestOffset + size < rangeEnd) {
+        freeRanges[bestOffset + size] = rangeEnd - (bestOffset + size);
+    }
+
+    allocations[bestOffset] = {size, kind};
+    used += size;
+    offset = bestOffset;
+    return true;
+}
+
+void FreeListAllocator::free(uint64_t offset) {
+    auto it = allocations.find(offset);
+    if (it == allocations.end()) {
+        throw std::runtime_error("freeing an unknown allocation!");
+    }
+
+    uint64_t begin = offset;
+    uint64_t end = offset + it->second.size;
+    used -= it->second.size;
+    allocations.erase(it);
+
+    // 和后面的空闲区间合并
+    auto next = freeRanges.find(end);
+    if (next != freeRanges.end()) {
+        end += next->second;
+        freeRanges.erase(next);
+    }
+
+    // 和前面的空闲区间合并
+    auto prev = freeRanges.lower_bound(begin);
+    if (prev != freeRanges.begin()) {
+        --prev;
+        if (prev->first + prev->second == begin) {
+            begin = prev->first;
+            freeRanges.erase(prev);
+        }
+    }
+
+    freeRanges[begin] = end - begin;
+}
+
+uint64_t FreeListAllocator::largestFreeRange() const {
+    uint64_t largest = 0;
+    for (const auto& range : freeRanges) {
+        largest = std::max(largest, range.second);
+    }
+    return largest;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+// 资源的内存排布方式。线性资源 (缓冲、线性图像) 和非线性资源 (OPTIMAL 图像) 放在同一个
+//   bufferImageGranularity 大小的 "页" 中时可能互相干扰, 所以分配时需要区分
+enum class AllocationKind {
+    Linear,
+    Optimal,
+};
+
+// 在一段 [0, size) 的地址空间上做子分配的空闲链表分配器 (只做地址计算, 不涉及 Vulkan 对象)。
+//   空闲区间和已分配区间都按偏移排序保存; 分配时选择能容纳请求的最小空闲区间 (best fit), 释放时和相邻的空闲区间合并。
+//   对齐产生的空隙也作为空闲区间保留, 释放后可以完整地合并回去。
+class FreeListAllocator {
+public:
+    FreeListAllocator(uint64_t size, uint64_t granularity);
+
+    // 分配 size 字节, 起始偏移按 alignment 对齐, 并保证不和不同 kind 的相邻分配共用一个 granularity 页。
+    //   成功时返回 true 并写入 offset, 空间不足时返回 false
+    bool allocate(uint64_t size, uint64_t alignment, AllocationKind kind, uint64_t& offset);
+    // 释放 offset 处的分配, offset 必须是 allocate 返回的值
+    void free(uint64_t offset);
+
+    uint64_t size() const { return totalSize; }
+    uint64_t usedBytes() const { return used; }
+    uint64_t freeBytes() const { return totalSize - used; }
+    uint64_t largestFreeRange() const;
+    size_t freeRangeCount() const { return freeRanges.size(); }
+    size_t allocationCount() const { return allocations.size(); }
+    bool empty() const { return allocations.empty(); }
+
+private:
+    struct Allocation {
+        uint64_t size;
+        AllocationKind kind;
+    };
+
+    bool onSamePage(uint64_t endOfFirst, uint64_t startOfSecond) const;
+
+    uint64_t totalSize;
+    uint64_t granularity;
+    uint64_t used = 0;
+    std::map<uint64_t, uint64_t> freeRanges;     // 偏移 -> 大小
+    std::map<uint64_t, Allocation> allocations;  // 偏移 -> 分配信息
+};
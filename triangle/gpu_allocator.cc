@@ -0,0 +1,225 @@
+#include "gpu_allocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+// 从驱动分配的一块内存
+struct GpuMemoryBlock {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    uint32_t memoryType = 0;
+    void* mapped = nullptr;  // 主机可见的块在创建时持久映射
+    FreeListAllocator ranges;
+
+    GpuMemoryBlock(VkDeviceSize size, VkDeviceSize granularity) : ranges(size, granularity) {}
+};
+
+GpuAllocator::GpuAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize)
+    : device(device), blockSize(blockSize)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    bufferImageGranularity = properties.limits.bufferImageGranularity;
+    maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+}
+
+GpuAllocator::~GpuAllocator() {
+    for (auto& block : blocks) {
+        if (block->mapped) {
+            vkUnmapMemory(device, block->memory);
+        }
+        vkFreeMemory(device, block->memory, nullptr);
+    }
+}
+
+bool GpuAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& typeIndex) const {
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            typeIndex = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+GpuMemoryBlock* GpuAllocator::createBlock(uint32_t memoryType, VkDeviceSize size) {
+    if (blocks.size() >= maxAllocationCount) {
+        throw std::runtime_error("exceeded maxMemoryAllocationCount!");
+    }
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        return nullptr;
+    }
+
+    auto block = std::make_unique<GpuMemoryBlock>(size, bufferImageGranularity);
+    block->memory = memory;
+    block->memoryType = memoryType;
+    if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) {
+            vkFreeMemory(device, memory, nullptr);
+            throw std::runtime_error("failed to map memory block!");
+        }
+    }
+
+    blocks.push_back(std::move(block));
+    return blocks.back().get();
+}
+
+void GpuAllocator::destroyBlock(GpuMemoryBlock* block) {
+    auto it = std::find_if(blocks.begin(), blocks.end(), [block](const auto& b) { return b.get() == block; });
+    if (block->mapped) {
+        vkUnmapMemory(device, block->memory);
+    }
+    vkFreeMemory(device, block->memory, nullptr);
+    blocks.erase(it);
+}
+
+GpuAllocation GpuAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, AllocationKind kind) {
+    uint32_t memoryType;
+    if (!findMemoryType(requirements.memoryTypeBits, properties, memoryType)) {
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    GpuAllocation allocation;
+    allocation.size = requirements.size;
+
+    auto assign = [&](GpuMemoryBlock* block, uint64_t offset) {
+        allocation.memory = block->memory;
+        allocation.offset = offset;
+        allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+        allocation.block = block;
+    };
+
+    uint64_t offset;
+    for (auto& block : blocks) {
+        if (block->memoryType == memoryType && block->ranges.allocate(requirements.size, requirements.alignment, kind, offset)) {
+            assign(block.get(), offset);
+            return allocation;
+        }
+    }
+
+    // 现有的块都放不下, 分配一个新块; 大于块大小的资源单独使用一块。内存紧张时退回到只分配资源本身需要的大小
+    GpuMemoryBlock* block = createBlock(memoryType, std::max(blockSize, requirements.size));
+    if (!block && requirements.size < blockSize) {
+        block = createBlock(memoryType, requirements.size);
+    }
+    if (!block || !block->ranges.allocate(requirements.size, requirements.alignment, kind, offset)) {
+        throw std::runtime_error("failed to allocate device memory!");
+    }
+    assign(block, offset);
+    return allocation;
+}
+
+void GpuAllocator::free(GpuAllocation& allocation) {
+    if (!allocation.block) {
+        return;
+    }
+
+    // 每种内存类型保留一个空的标准大小的块: 每次上传都创建又释放的暂存缓冲不会反复 vkAllocateMemory / vkFreeMemory。
+    //   单独分配的超大块、内存紧张时分配的小块和多余的空块立即还给驱动
+    GpuMemoryBlock* block = allocation.block;
+    block->ranges.free(allocation.offset);
+    if (block->ranges.empty()) {
+        bool keep = block->ranges.size() == blockSize;
+        for (const auto& other : blocks) {
+            if (other.get() != block && other->memoryType == block->memoryType && other->ranges.empty()) {
+                keep = false;
+            }
+        }
+        if (!keep) {
+            destroyBlock(block);
+        }
+    }
+    allocation = GpuAllocation{};
+}
+
+void GpuAllocator::createBuffer(const VkBufferCreateInfo& createInfo, VkMemoryPropertyFlags properties, VkBuffer& buffer, GpuAllocation& allocation) {
+    if (vkCreateBuffer(device, &createInfo, nullptr, &buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+    try {
+        allocation = allocate(memRequirements, properties, AllocationKind::Linear);
+    } catch (...) {
+        vkDestroyBuffer(device, buffer, nullptr);
+        throw;
+    }
+    vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+}
+
+void GpuAllocator::createImage(const VkImageCreateInfo& createInfo, VkMemoryPropertyFlags properties, VkImage& image, GpuAllocation& allocation) {
+    if (vkCreateImage(device, &createInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+    AllocationKind kind = createInfo.tiling == VK_IMAGE_TILING_OPTIMAL ? AllocationKind::Optimal : AllocationKind::Linear;
+    try {
+        allocation = allocate(memRequirements, properties, kind);
+    } catch (...) {
+        vkDestroyImage(device, image, nullptr);
+        throw;
+    }
+    vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+}
+
+void GpuAllocator::destroyBuffer(VkBuffer buffer, GpuAllocation& allocation) {
+    vkDestroyBuffer(device, buffer, nullptr);
+    free(allocation);
+}
+
+void GpuAllocator::destroyImage(VkImage image, GpuAllocation& allocation) {
+    vkDestroyImage(device, image, nullptr);
+    free(allocation);
+}
+
+std::vector<GpuHeapStats> GpuAllocator::heapStats() const {
+    std::vector<GpuHeapStats> stats(memoryProperties.memoryHeapCount);
+    for (const auto& block : blocks) {
+        GpuHeapStats& heap = stats[memoryProperties.memoryTypes[block->memoryType].heapIndex];
+        heap.blockBytes += block->ranges.size();
+        heap.usedBytes += block->ranges.usedBytes();
+        heap.blockCount++;
+        heap.allocationCount += static_cast<uint32_t>(block->ranges.allocationCount());
+    }
+    return stats;
+}
+
+double GpuAllocator::fragmentation() const {
+    // 资源不能跨块, 所以按块统计: 每个块内最大的空闲区间之和 / 总空闲空间
+    uint64_t freeBytes = 0;
+    uint64_t largestBytes = 0;
+    for (const auto& block : blocks) {
+        freeBytes += block->ranges.freeBytes();
+        largestBytes += block->ranges.largestFreeRange();
+    }
+    return freeBytes == 0 ? 0.0 : 1.0 - static_cast<double>(largestBytes) / freeBytes;
+}
+
+void GpuAllocator::printStats(std::ostream& out) const {
+    const double mb = 1024.0 * 1024.0;
+    out << "gpu memory: " << blocks.size() << " device allocations (limit " << maxAllocationCount << "), fragmentation "
+        << fragmentation() * 100.0 << "%\n";
+
+    std::vector<GpuHeapStats> stats = heapStats();
+    for (size_t i = 0; i < stats.size(); i++) {
+        if (stats[i].blockCount == 0) {
+            continue;
+        }
+        out << "  heap " << i << ": " << stats[i].usedBytes / mb << " / " << stats[i].blockBytes / mb << " MB used, "
+            << stats[i].allocationCount << " allocations in " << stats[i].blockCount << " blocks\n";
+    }
+    out.flush();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "free_list_allocator.h"
+
+struct GpuMemoryBlock;
+
+// 一次子分配的结果: 资源绑定到 memory 的 offset 处
+struct GpuAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;          // 主机可见内存的映射地址 (已经加上 offset), 否则为 nullptr
+    GpuMemoryBlock* block = nullptr;
+};
+
+// 每个内存堆的统计信息
+struct GpuHeapStats {
+    VkDeviceSize blockBytes = 0;  // 从驱动分配的内存总量
+    VkDeviceSize usedBytes = 0;   // 已经分配给资源的内存总量
+    uint32_t blockCount = 0;
+    uint32_t allocationCount = 0;
+};
+
+// 设备内存分配器: 按内存类型从驱动分配大块内存 (默认 64 MB), 资源从块中子分配。
+//   vkAllocateMemory 的调用次数受 maxMemoryAllocationCount 限制 (通常只有 4096), 而且本身很慢, 所以不能每个资源分配一次。
+//   主机可见的块在创建时持久映射, 子分配直接得到映射地址。
+class GpuAllocator {
+public:
+    static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+    GpuAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+    ~GpuAllocator();
+
+    GpuAllocator(const GpuAllocator&) = delete;
+    GpuAllocator& operator=(const GpuAllocator&) = delete;
+
+    // 为满足 requirements 的资源分配内存, 找不到满足 properties 的内存类型或者内存不足时抛出异常
+    GpuAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, AllocationKind kind);
+    void free(GpuAllocation& allocation);
+
+    // 创建缓冲/图像并绑定到新分配的内存
+    void createBuffer(const VkBufferCreateInfo& createInfo, VkMemoryPropertyFlags properties, VkBuffer& buffer, GpuAllocation& allocation);
+    void createImage(const VkImageCreateInfo& createInfo, VkMemoryPropertyFlags properties, VkImage& image, GpuAllocation& allocation);
+    void destroyBuffer(VkBuffer buffer, GpuAllocation& allocation);
+    void destroyImage(VkImage image, GpuAllocation& allocation);
+
+    // 查找满足 typeFilter (资源的 memoryTypeBits) 和所需属性的内存类型, 没有时返回 false
+    bool findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& typeIndex) const;
+
+    std::vector<GpuHeapStats> heapStats() const;
+    // 碎片率: 1 - 最大空闲区间 / 总空闲空间, 0 表示所有空闲空间都是连续的
+    double fragmentation() const;
+    uint32_t deviceAllocationCount() const { return static_cast<uint32_t>(blocks.size()); }
+    void printStats(std::ostream& out) const;
+
+private:
+    GpuMemoryBlock* createBlock(uint32_t memoryType, VkDeviceSize size);
+    void destroyBlock(GpuMemoryBlock* block);
+
+    VkDevice device;
+    VkDeviceSize blockSize;
+    VkDeviceSize bufferImageGranularity;
+    uint32_t maxAllocationCount;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    std::vector<std::unique_ptr<GpuMemoryBlock>> blocks;
+};
@@ -0,0 +1,181 @@
+#include "gpu_profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+GpuProfiler::GpuProfiler(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount,
+                         uint32_t maxScopes, uint32_t historyLength)
+    : device(device), maxScopes(maxScopes), historyLength(historyLength)
+{
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+    uint32_t validBits = queueFamilyIndex < queueFamilyCount ? queueFamilies[queueFamilyIndex].timestampValidBits : 0;
+    if (validBits == 0) {
+        throw std::runtime_error("GPU profiling requires timestamp support on the graphics queue!");
+    }
+    timestampMask = validBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << validBits) - 1;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    nsPerTick = properties.limits.timestampPeriod;  // 时间戳每增加 1 经过的纳秒数
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = maxScopes * 2;
+
+    frames.resize(frameCount);
+    for (auto& frame : frames) {
+        if (vkCreateQueryPool(device, &poolInfo, nullptr, &frame.queryPool) != VK_SUCCESS) {
+            for (auto& created : frames) {
+                vkDestroyQueryPool(device, created.queryPool, nullptr);
+            }
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+        frame.scopes.reserve(maxScopes);
+    }
+    results.resize(static_cast<size_t>(maxScopes) * 2 * 2);
+    lastTimings.reserve(maxScopes);
+}
+
+GpuProfiler::~GpuProfiler() {
+    for (auto& frame : frames) {
+        vkDestroyQueryPool(device, frame.queryPool, nullptr);
+    }
+}
+
+uint32_t GpuProfiler::scopeId(const std::string& name) {
+    auto it = scopeIds.find(name);
+    if (it != scopeIds.end()) {
+        return it->second;
+    }
+    uint32_t id = static_cast<uint32_t>(histories.size());
+    ScopeHistory history;
+    history.name = name;
+    history.samples.reserve(historyLength);
+    histories.push_back(std::move(history));
+    scopeIds.emplace(name, id);
+    return id;
+}
+
+void GpuProfiler::collect(uint32_t frame) {
+    FrameQueries& queries = frames[frame];
+    lastTimings.clear();
+    if (!queries.pending) {
+        return;
+    }
+    queries.pending = false;
+
+    uint32_t queryCount = static_cast<uint32_t>(queries.scopes.size()) * 2;
+    if (queryCount == 0) {
+        return;
+    }
+    // 不使用 VK_QUERY_RESULT_WAIT_BIT: 该帧已经执行完毕, 结果应该都可用; 个别不可用 (例如范围没有结束) 时返回 VK_NOT_READY,
+    //   通过每个查询的可用性标志跳过这些范围
+    VkResult result = vkGetQueryPoolResults(device, queries.queryPool, 0, queryCount, queryCount * 2 * sizeof(uint64_t), results.data(),
+                                            2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        throw std::runtime_error("failed to read timestamp queries!");
+    }
+
+    // 范围 0 是 "frame", 其它范围的开始时间相对于它计算
+    uint64_t frameBegin = results[1] != 0 ? results[0] : 0;
+    for (size_t i = 0; i < queries.scopes.size(); i++) {
+        const uint64_t* begin = &results[i * 4];
+        const uint64_t* end = &results[i * 4 + 2];
+        if (begin[1] == 0 || end[1] == 0) {
+            continue;
+        }
+        uint64_t ticks = ((end[0] & timestampMask) - (begin[0] & timestampMask)) & timestampMask;
+        double ms = ticks * nsPerTick / 1e6;
+        double offsetMs = (((begin[0] & timestampMask) - (frameBegin & timestampMask)) & timestampMask) * nsPerTick / 1e6;
+        lastTimings.push_back({queries.scopes[i], offsetMs, offsetMs + ms});
+
+        ScopeHistory& history = histories[queries.scopes[i]];
+        if (history.samples.size() < historyLength) {
+            history.samples.push_back(ms);
+        } else {
+            history.samples[history.next] = ms;
+        }
+        history.next = (history.next + 1) % historyLength;
+        history.lastMs = ms;
+    }
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frame) {
+    FrameQueries& queries = frames[frame];
+    queries.scopes.clear();
+    queries.pending = true;
+    recordingFrame = frame;
+
+    // 查询在写入前必须重置 (只能在渲染流程之外)
+    vkCmdResetQueryPool(commandBuffer, queries.queryPool, 0, maxScopes * 2);
+    beginScope(commandBuffer, "frame");
+}
+
+void GpuProfiler::endFrame(VkCommandBuffer commandBuffer) {
+    endScope(commandBuffer, 0);
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const std::string& name) {
+    FrameQueries& queries = frames[recordingFrame];
+    if (queries.scopes.size() >= maxScopes) {
+        return UINT32_MAX;
+    }
+    uint32_t scope = static_cast<uint32_t>(queries.scopes.size());
+    queries.scopes.push_back(scopeId(name));
+    // TOP_OF_PIPE: 之前的指令开始执行后写入; 和 endScope 的 BOTTOM_OF_PIPE 一起覆盖范围内指令的全部执行时间
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queries.queryPool, scope * 2);
+    return scope;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope) {
+    if (scope == UINT32_MAX) {
+        return;
+    }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frames[recordingFrame].queryPool, scope * 2 + 1);
+}
+
+std::vector<GpuScopeStats> GpuProfiler::stats() const {
+    std::vector<GpuScopeStats> result;
+    for (const auto& history : histories) {
+        GpuScopeStats scope;
+        scope.name = history.name;
+        scope.lastMs = history.lastMs;
+        scope.samples = static_cast<uint32_t>(history.samples.size());
+        if (!history.samples.empty()) {
+            double total = 0.0;
+            for (double ms : history.samples) {
+                total += ms;
+            }
+            scope.avgMs = total / history.samples.size();
+            scope.minMs = *std::min_element(history.samples.begin(), history.samples.end());
+            scope.maxMs = *std::max_element(history.samples.begin(), history.samples.end());
+        }
+        result.push_back(std::move(scope));
+    }
+    return result;
+}
+
+void GpuProfiler::printSummary(std::ostream& out) const {
+    out << "gpu:";
+    const char* separator = " ";
+    for (const auto& scope : stats()) {
+        out << separator << scope.name << " " << std::fixed << std::setprecision(3) << scope.avgMs << " ms";
+        separator = " | ";
+    }
+    out << std::defaultfloat << std::endl;
+}
+
+void GpuProfiler::printReport(std::ostream& out) const {
+    out << "gpu timing (last " << historyLength << " frames, ms):\n";
+    for (const auto& scope : stats()) {
+        out << "  " << std::left << std::setw(24) << scope.name << std::right << std::fixed << std::setprecision(3)
+            << " avg " << scope.avgMs << "  min " << scope.minMs << "  max " << scope.maxMs << "  last " << scope.lastMs
+            << std::defaultfloat << "  (" << scope.samples << " samples)\n";
+    }
+    out << std::flush;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 一个计时范围最近若干帧的 GPU 耗时统计
+struct GpuScopeStats {
+    std::string name;
+    double lastMs = 0.0;
+    double avgMs = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+    uint32_t samples = 0;  // 参与统计的帧数 (不超过历史长度)
+};
+
+// 一个计时范围在某一帧中的时间, 相对于这一帧 "frame" 范围的开始
+struct GpuScopeTiming {
+    uint32_t scope;  // 范围的编号, 用 GpuProfiler::scopeName 取得名字
+    double beginMs;
+    double endMs;
+};
+
+// GPU 时间戳查询分析器: 录制时在渲染流程和自定义范围的前后写入时间戳 (vkCmdWriteTimestamp), 用 timestampPeriod 换算成毫秒。
+//   每个 in-flight 帧有自己的查询池, 该帧的提交执行完毕后结果一定已经可用, 调用 collect 读回时不需要等待 GPU。
+//   每个范围按名字保存最近 historyLength 帧的耗时, 用于滚动显示。
+//
+//   用法 (每帧): 该帧的提交执行完毕后 collect(frame); 录制时 beginFrame, 若干对 beginScope/endScope (不能在渲染流程内), endFrame。
+//   整帧的耗时记在名为 "frame" 的范围中。
+class GpuProfiler {
+public:
+    static const uint32_t DEFAULT_MAX_SCOPES = 32;     // 每帧最多的计时范围数 (包括 "frame")
+    static const uint32_t DEFAULT_HISTORY_LENGTH = 240;
+
+    // queueFamilyIndex: 提交这些指令缓冲的队列族 (决定时间戳的有效位数)。队列族不支持时间戳时抛出异常
+    GpuProfiler(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount,
+                uint32_t maxScopes = DEFAULT_MAX_SCOPES, uint32_t historyLength = DEFAULT_HISTORY_LENGTH);
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // 读回 frame 上一次录制的结果并计入历史 (调用前必须确认该帧已经执行完毕; 没有未读回的结果时什么也不做)
+    void collect(uint32_t frame);
+
+    // 开始录制 frame: 重置该帧的查询并开始 "frame" 范围 (在指令缓冲开头、渲染流程之外调用)
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frame);
+    void endFrame(VkCommandBuffer commandBuffer);
+
+    // 开始一个计时范围, 返回传给 endScope 的句柄。范围数超过上限时这个范围不计时
+    uint32_t beginScope(VkCommandBuffer commandBuffer, const std::string& name);
+    void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+    // 最近一次 collect 读回的各范围时间 (没有读回结果时为空), 用于把 GPU 范围合并到 CPU 时间线
+    const std::vector<GpuScopeTiming>& lastFrame() const { return lastTimings; }
+    const std::string& scopeName(uint32_t scope) const { return histories[scope].name; }
+
+    // 所有范围的统计, 按第一次出现的顺序
+    std::vector<GpuScopeStats> stats() const;
+    // 一行的摘要 (各范围最近若干帧的平均耗时), 用于运行时定期输出
+    void printSummary(std::ostream& out) const;
+    // 完整的统计表
+    void printReport(std::ostream& out) const;
+
+private:
+    struct FrameQueries {
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        std::vector<uint32_t> scopes;  // 这一帧录制的范围 (范围 i 使用查询 2i 和 2i+1), 值为 histories 的索引
+        bool pending = false;          // 已经录制, 还没有读回
+    };
+
+    struct ScopeHistory {
+        std::string name;
+        std::vector<double> samples;  // 环形缓冲
+        size_t next = 0;
+        double lastMs = 0.0;
+    };
+
+    uint32_t scopeId(const std::string& name);
+
+    VkDevice device;
+    uint32_t maxScopes;
+    uint32_t historyLength;
+    double nsPerTick;        // timestampPeriod
+    uint64_t timestampMask;  // 时间戳的有效位
+
+    std::vector<FrameQueries> frames;
+    uint32_t recordingFrame = 0;
+    std::vector<uint64_t> results;  // 读回结果用的缓冲 (每个查询一个值和一个可用性标志)
+    std::vector<GpuScopeTiming> lastTimings;
+
+    std::vector<ScopeHistory> histories;
+    std::unordered_map<std::string, uint32_t> scopeIds;
+};
@@ -0,0 +1,440 @@
+#include "pipeline_builder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+VkShaderModule createShaderModule(VkDevice device, const uint32_t* code, size_t size) {
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = size;
+    createInfo.pCode = code;  // 可以直接指向映射的着色器归档, 不需要复制
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shader module!");
+    }
+    // 调用vkCreateShaderModule 函数后,code不再需要了，我们就可以立即释放掉存储着色器字节码的数组code内存
+
+    return shaderModule;
+}
+
+VkPipeline createGraphicsPipeline(VkDevice device, const GraphicsPipelineDesc& desc, VkPipelineCache cache) {
+    VkShaderModule vertShaderModule = createShaderModule(device, desc.vertexShader.code, desc.vertexShader.size);
+    VkShaderModule fragShaderModule;
+    try {
+        fragShaderModule = createShaderModule(device, desc.fragmentShader.code, desc.fragmentShader.size);
+    } catch (...) {
+        vkDestroyShaderModule(device, vertShaderModule, nullptr);
+        throw;
+    }
+
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;  // 指定着色器在管线的哪一阶段被使用
+    vertShaderStageInfo.module = vertShaderModule; // 指定使用的着色器模块对象
+    vertShaderStageInfo.pName = "main";  // 指定调用的着色器函数 (在同一份代码中可以实现多个片段着色器,然后通过不同的 "函数名" 调用它们)
+    // 可以通过 pSpecializationInfo 指定着色器用到的常量, 我们可以对同一个着色器模块对象指定不同
+    // 的着色器常量用于管线创建,这使得编译器可以根据指定的着色器常量来消除一些条件分支,这比在渲染
+    // 时,使用变量配置着色器带来的效率要高得多。如果不使用着色器常量,可以将它设置为 nullptr。
+    // （理解：类似设置给shader设置Uniform常量）
+    // 常量的值由描述中的变体键决定 (见 ShaderVariants), 没有变体声明时 info() 返回 nullptr
+    ShaderSpecialization vertSpecialization;
+    if (desc.vertexVariants) {
+        desc.vertexVariants->specialize(desc.vertexVariantKey, vertSpecialization);
+    }
+    vertShaderStageInfo.pSpecializationInfo = vertSpecialization.info();
+
+    VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragShaderStageInfo.module = fragShaderModule;
+    fragShaderStageInfo.pName = "main";
+    ShaderSpecialization fragSpecialization;
+    if (desc.fragmentVariants) {
+        desc.fragmentVariants->specialize(desc.fragmentVariantKey, fragSpecialization);
+    }
+    fragShaderStageInfo.pSpecializationInfo = fragSpecialization.info();
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+
+    // 顶点输入 (描述传递给顶点着色器的顶点数据格式)
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(desc.vertexBindings.size());
+    vertexInputInfo.pVertexBindingDescriptions = desc.vertexBindings.data();
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.vertexAttributes.size());
+    vertexInputInfo.pVertexAttributeDescriptions = desc.vertexAttributes.data();
+
+    // 输入装配 (描述两个信息:顶点数据定义了哪种类型的几何图元,以及是否启用几何图元重启)
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = desc.topology;  // 例如 VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST: 每三个顶点构成一个三角形图元
+    inputAssembly.primitiveRestartEnable = VK_FALSE; // 用于带有 _STRIP 结尾的图元类型
+
+    // 视口和裁剪 （可以使用多个视口和裁剪矩形）
+    // 视口： 定义了图像到帧缓冲的映射关系
+    // 裁剪： 定义了哪一区域的像素实际被存储在帧缓存。任何位于裁剪矩形外的像素都会被光栅化程序丢弃。
+    // 这里只指定数量, 具体的值作为动态状态在录制指令缓冲时设置, 这样交换链尺寸改变时不需要重建管线。
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1; // 视口数量
+    viewportState.pViewports = nullptr;
+    viewportState.scissorCount = 1; // 裁剪数量
+    viewportState.pScissors = nullptr;
+
+    // 动态状态: 这些状态不固定在管线中, 需要在绘制前通过 vkCmdSetViewport/vkCmdSetScissor 指定
+    std::vector<VkDynamicState> dynamicStates = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    // 光栅化
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE; // VK_TRUE 表示在近平面和远平面外的片段会被截断为在近平面和远平面上,而不是直接丢弃这些片段。
+                                            // 这对于阴影贴图的生成很有用。使用这一设置需要开启相应的 GPU 特性。
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;  // VK_TRUE 表示所有几何图元都不能通过光栅化阶段。这一设置会禁止一切片段输出到帧缓冲。
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;  // 指定几何图元生成片段的方式： VK_POLYGON_MODE_FILL表示整个多边形,包括多边形内部都产生片段
+    rasterizer.lineWidth = 1.0f;  // lineWidth 成员变量用于指定光栅化后的线段宽度,它以线宽所占的片段数目为单位。
+                                  // 线宽的最大值依赖于硬件,使用大于 1.0f 的线宽,需要启用相应的 GPU 特性。
+    rasterizer.cullMode = desc.cullMode; // 指定使用的表面剔除类型
+    rasterizer.frontFace = desc.frontFace; // 指定顺时针的顶点序是正面,还是逆时针的顶点序是正面
+    rasterizer.depthBiasEnable = VK_FALSE;  // 光栅化程序可以添加一个常量值或是一个基于片段所处线段的斜率得到的变量值到深度值上。
+                                            // 这对于阴影贴图会很有用,但在这里,我们不使用它,所以将 depthBiasEnable 成员变量设置为 VK_FALSE。
+
+    // 多重采样
+    // 多重采样是一种组合多个不同多边形产生的片段的颜色来决定最终的像素颜色的技术,它可以一定程度上减少多边形边缘的走样现象。
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    // 颜色混合
+    // 片段着色器返回的片段颜色需要和原来帧缓冲中对应像素的颜色进行混合。混合的方式有下面两种:
+    //    1) 混合旧值和新值产生最终的颜色
+    //    2) 使用位运算组合旧值和新值
+    // 通常,我们使用颜色混合是为了进行 alpha 混合来实现半透明效果。
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = desc.blendEnable ? VK_TRUE : VK_FALSE; // VK_FALSE,就不会进行混合操作。否则,就会执行指定的混合操作计算新的颜色值。
+                                                 // 计算出的新的颜色值会按照 colorWriteMask 的设置决定写入到帧缓冲的颜色通道。
+    colorBlendAttachment.srcColorBlendFactor = desc.srcColorBlendFactor;  // 新颜色 * src + 旧颜色 * dst
+    colorBlendAttachment.dstColorBlendFactor = desc.dstColorBlendFactor;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+    for (int i = 0; i < 4; i++) {
+        colorBlending.blendConstants[i] = desc.blendConstants[i];  // 混合因子为 VK_BLEND_FACTOR_CONSTANT_* 时使用
+    }
+
+    // 创建管线对象
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = desc.layout;          // 指定之前创建的管线布局
+    pipelineInfo.renderPass = desc.renderPass;  // 引用之前创建的渲染流程对象 (管线也可以用于和它兼容的其它渲染流程)
+    pipelineInfo.subpass = desc.subpass;        // 子流程在子流程数组中的索引
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    // 传入管线缓存: 缓存中已有相同管线的编译结果时, 驱动可以直接使用, 跳过编译
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &pipeline);
+
+    // 注意，着色器模块对象只在管线创建时需要，用完了可以销毁
+    vkDestroyShaderModule(device, fragShaderModule, nullptr);
+    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+    return pipeline;
+}
+
+
+// 把一个标量值的字节追加到键中 (只用于整数、枚举和浮点数, 不用于可能含有填充字节的结构体)
+template <typename T>
+static void appendKey(std::string& key, const T& value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// 着色器的标识: 字节码的哈希和长度 (同一份 SPIR-V 不论从哪里加载都视为同一个着色器), 以及选中的变体。
+//   变体声明属于着色器, 同一个着色器的变体键相同就是同一组特化常量
+static void appendShaderKey(std::string& key, const ShaderCode& shader, const std::shared_ptr<const ShaderVariants>& variants,
+                            uint64_t variantKey) {
+    appendKey(key, shader.hash);
+    appendKey(key, static_cast<uint64_t>(shader.size));
+    appendKey(key, static_cast<uint8_t>(variants != nullptr));
+    appendKey(key, variants ? variantKey : uint64_t(0));
+}
+
+static bool usesBlendConstants(VkBlendFactor factor) {
+    return factor == VK_BLEND_FACTOR_CONSTANT_COLOR || factor == VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_COLOR ||
+           factor == VK_BLEND_FACTOR_CONSTANT_ALPHA || factor == VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA;
+}
+
+static void appendAttachmentReferenceKey(std::string& key, const VkRenderPassCreateInfo& info, const VkAttachmentReference& ref) {
+    // 引用的兼容性只取决于被引用附着的格式和采样数 (布局不影响兼容性)
+    if (ref.attachment == VK_ATTACHMENT_UNUSED) {
+        appendKey(key, ref.attachment);
+        return;
+    }
+    appendKey(key, info.pAttachments[ref.attachment].format);
+    appendKey(key, info.pAttachments[ref.attachment].samples);
+}
+
+PipelineBuilder::PipelineBuilder(VkDevice device, TaskScheduler& scheduler, VkPipelineCache cache)
+    : device(device), scheduler(scheduler), cache(cache)
+{
+}
+
+PipelineBuilder::~PipelineBuilder() {
+    waitAll();
+    for (auto& build : builds) {
+        if (build->pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, build->pipeline, nullptr);
+        }
+    }
+}
+
+void PipelineBuilder::registerRenderPass(VkRenderPass renderPass, const VkRenderPassCreateInfo& info) {
+    std::string key;
+    appendKey(key, info.flags);
+    appendKey(key, info.attachmentCount);
+    for (uint32_t i = 0; i < info.attachmentCount; i++) {
+        appendKey(key, info.pAttachments[i].flags);
+        appendKey(key, info.pAttachments[i].format);
+        appendKey(key, info.pAttachments[i].samples);
+    }
+    appendKey(key, info.subpassCount);
+    for (uint32_t i = 0; i < info.subpassCount; i++) {
+        const VkSubpassDescription& subpass = info.pSubpasses[i];
+        appendKey(key, subpass.flags);
+        appendKey(key, subpass.pipelineBindPoint);
+        appendKey(key, subpass.inputAttachmentCount);
+        for (uint32_t j = 0; j < subpass.inputAttachmentCount; j++) {
+            appendAttachmentReferenceKey(key, info, subpass.pInputAttachments[j]);
+        }
+        appendKey(key, subpass.colorAttachmentCount);
+        for (uint32_t j = 0; j < subpass.colorAttachmentCount; j++) {
+            appendAttachmentReferenceKey(key, info, subpass.pColorAttachments[j]);
+            if (subpass.pResolveAttachments) {
+                appendAttachmentReferenceKey(key, info, subpass.pResolveAttachments[j]);
+            }
+        }
+        appendKey(key, subpass.pDepthStencilAttachment != nullptr);
+        if (subpass.pDepthStencilAttachment) {
+            appendAttachmentReferenceKey(key, info, *subpass.pDepthStencilAttachment);
+        }
+        // preserve 附着不影响兼容性
+    }
+    appendKey(key, info.dependencyCount);
+    for (uint32_t i = 0; i < info.dependencyCount; i++) {
+        const VkSubpassDependency& dependency = info.pDependencies[i];
+        appendKey(key, dependency.srcSubpass);
+        appendKey(key, dependency.dstSubpass);
+        appendKey(key, dependency.srcStageMask);
+        appendKey(key, dependency.dstStageMask);
+        appendKey(key, dependency.srcAccessMask);
+        appendKey(key, dependency.dstAccessMask);
+        appendKey(key, dependency.dependencyFlags);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto result = renderPassClassIds.emplace(key, static_cast<uint32_t>(renderPassClassIds.size()));
+    // 渲染流程销毁后句柄可能被新的渲染流程重用, 直接覆盖
+    renderPassClasses[renderPass] = result.first->second;
+    registryStats.renderPassClasses = static_cast<uint32_t>(renderPassClassIds.size());
+}
+
+bool PipelineBuilder::isCompatible(VkRenderPass a, VkRenderPass b) const {
+    if (a == b) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    auto classA = renderPassClasses.find(a);
+    auto classB = renderPassClasses.find(b);
+    return classA != renderPassClasses.end() && classB != renderPassClasses.end() && classA->second == classB->second;
+}
+
+// 规范化的管线状态键。不起作用的状态按默认值参与计算, 这样只在这些状态上不同的描述会得到同一个管线
+std::string PipelineBuilder::stateKey(const GraphicsPipelineDesc& desc) const {
+    std::string key;
+    appendShaderKey(key, desc.vertexShader, desc.vertexVariants, desc.vertexVariantKey);
+    appendShaderKey(key, desc.fragmentShader, desc.fragmentVariants, desc.fragmentVariantKey);
+
+    // 顶点输入按 binding / location 排序, 声明的顺序不影响管线
+    std::vector<VkVertexInputBindingDescription> bindings = desc.vertexBindings;
+    std::sort(bindings.begin(), bindings.end(), [](const VkVertexInputBindingDescription& a, const VkVertexInputBindingDescription& b) {
+        return a.binding < b.binding;
+    });
+    appendKey(key, static_cast<uint32_t>(bindings.size()));
+    for (auto& binding : bindings) {
+        appendKey(key, binding.binding);
+        appendKey(key, binding.stride);
+        appendKey(key, binding.inputRate);
+    }
+    std::vector<VkVertexInputAttributeDescription> attributes = desc.vertexAttributes;
+    std::sort(attributes.begin(), attributes.end(), [](const VkVertexInputAttributeDescription& a, const VkVertexInputAttributeDescription& b) {
+        return a.location < b.location;
+    });
+    appendKey(key, static_cast<uint32_t>(attributes.size()));
+    for (auto& attribute : attributes) {
+        appendKey(key, attribute.location);
+        appendKey(key, attribute.binding);
+        appendKey(key, attribute.format);
+        appendKey(key, attribute.offset);
+    }
+
+    appendKey(key, desc.topology);
+    appendKey(key, desc.cullMode);
+    // 不剔除时正面的朝向不起作用
+    appendKey(key, desc.cullMode == VK_CULL_MODE_NONE ? VK_FRONT_FACE_CLOCKWISE : desc.frontFace);
+
+    // 关闭混合时混合因子和混合常量都不起作用; 混合因子不使用常量时混合常量不起作用
+    appendKey(key, desc.blendEnable);
+    if (desc.blendEnable) {
+        appendKey(key, desc.srcColorBlendFactor);
+        appendKey(key, desc.dstColorBlendFactor);
+        if (usesBlendConstants(desc.srcColorBlendFactor) || usesBlendConstants(desc.dstColorBlendFactor)) {
+            for (float constant : desc.blendConstants) {
+                appendKey(key, constant);
+            }
+        }
+    }
+
+    appendKey(key, desc.layout);
+    // 渲染流程用兼容类代替句柄, 兼容的渲染流程共用管线
+    auto renderPassClass = renderPassClasses.find(desc.renderPass);
+    if (renderPassClass != renderPassClasses.end()) {
+        appendKey(key, 'C');
+        appendKey(key, renderPassClass->second);
+    } else {
+        appendKey(key, 'H');
+        appendKey(key, desc.renderPass);
+    }
+    appendKey(key, desc.subpass);
+    return key;
+}
+
+PipelineFuture PipelineBuilder::request(const GraphicsPipelineDesc& desc) {
+    PipelineFuture future;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        registryStats.requests++;
+        std::string key = stateKey(desc);
+        auto existing = registry.find(key);
+        if (existing != registry.end()) {
+            registryStats.hits++;
+            return existing->second;
+        }
+        registryStats.misses++;
+
+        future.state = std::make_shared<PipelineFuture::State>();
+        builds.push_back(future.state);
+        registry.emplace(std::move(key), future);
+    }
+
+    pending.fetch_add(1, std::memory_order_relaxed);
+    // 编译错误记录在 future 中, 不从任务中抛出: 后台编译失败不是错误 (退回到基础管线), 只有 wait 这个 future 时才抛出
+    std::shared_ptr<PipelineFuture::State> state = future.state;
+    scheduler.submit([this, desc, state] {
+        auto start = std::chrono::steady_clock::now();
+        try {
+            state->pipeline = createGraphicsPipeline(device, desc, cache);
+        } catch (const std::exception& e) {
+            state->error = e.what();
+        }
+        state->buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        state->status.store(state->pipeline != VK_NULL_HANDLE ? PipelineFuture::Ready : PipelineFuture::Failed,
+                            std::memory_order_release);
+        pending.fetch_sub(1, std::memory_order_release);
+    }, &state->done);
+    return future;
+}
+
+VkPipeline PipelineBuilder::wait(const PipelineFuture& future) {
+    scheduler.wait(future.state->done);
+    if (future.failed()) {
+        throw std::runtime_error("failed to build pipeline: " + future.state->error);
+    }
+    return future.get();
+}
+
+void PipelineBuilder::waitAll() {
+    std::vector<std::shared_ptr<PipelineFuture::State>> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        snapshot = builds;
+    }
+    for (auto& build : snapshot) {
+        scheduler.wait(build->done);
+    }
+}
+
+void PipelineBuilder::release(const PipelineFuture& future) {
+    if (!future.valid()) {
+        return;
+    }
+    scheduler.wait(future.state->done);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto build = std::find(builds.begin(), builds.end(), future.state);
+    if (build == builds.end()) {
+        return;
+    }
+    builds.erase(build);
+    for (auto it = registry.begin(); it != registry.end();) {
+        it = it->second == future ? registry.erase(it) : std::next(it);
+    }
+    if (future.state->pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device, future.state->pipeline, nullptr);
+    }
+}
+
+uint32_t PipelineBuilder::builtCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t count = 0;
+    for (auto& build : builds) {
+        if (build->status.load(std::memory_order_acquire) == PipelineFuture::Ready) {
+            count++;
+        }
+    }
+    return count;
+}
+
+PipelineRegistryStats PipelineBuilder::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return registryStats;
+}
+
+double PipelineBuilder::totalBuildMs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    double total = 0.0;
+    for (auto& build : builds) {
+        if (build->status.load(std::memory_order_acquire) != PipelineFuture::Pending) {
+            total += build->buildMs;
+        }
+    }
+    return total;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shader_archive.h"
+#include "shader_variant.h"
+#include "task_scheduler.h"
+
+// 图形管线的描述: 创建一个管线需要的全部状态 (视口和裁剪始终是动态状态, 不在描述中)
+struct GraphicsPipelineDesc {
+    ShaderCode vertexShader;    // SPIR-V 字节码, 多个描述可以共用同一份 (例如都指向映射的着色器归档)
+    ShaderCode fragmentShader;
+    // 着色器的变体声明和选中的变体键, 为空时不使用特化常量 (变体声明只读, 可以被多个描述和编译任务共享)
+    std::shared_ptr<const ShaderVariants> vertexVariants;
+    uint64_t vertexVariantKey = 0;
+    std::shared_ptr<const ShaderVariants> fragmentVariants;
+    uint64_t fragmentVariantKey = 0;
+    std::vector<VkVertexInputBindingDescription> vertexBindings;
+    std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+    bool blendEnable = false;
+    VkBlendFactor srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    VkBlendFactor dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+    float blendConstants[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+};
+
+// 创建着色器模块对象, 失败时抛出异常
+VkShaderModule createShaderModule(VkDevice device, const uint32_t* code, size_t size);
+
+// 按描述创建图形管线 (在调用线程上同步编译)。失败时抛出异常
+VkPipeline createGraphicsPipeline(VkDevice device, const GraphicsPipelineDesc& desc, VkPipelineCache cache);
+
+// 异步编译的管线。ready() 之后 get() 返回管线句柄, 编译失败时 failed() 为 true。
+//   可以在任意线程上轮询 (只读取原子变量), 复制后共享同一个结果。
+class PipelineFuture {
+public:
+    PipelineFuture() = default;
+
+    bool valid() const { return state != nullptr; }
+    bool ready() const { return state && state->status.load(std::memory_order_acquire) == Ready; }
+    bool failed() const { return state && state->status.load(std::memory_order_acquire) == Failed; }
+    // 未完成或失败时返回 VK_NULL_HANDLE
+    VkPipeline get() const { return ready() ? state->pipeline : VK_NULL_HANDLE; }
+    // 去重后相同的请求得到同一个结果
+    bool operator==(const PipelineFuture& other) const { return state == other.state; }
+
+private:
+    friend class PipelineBuilder;
+
+    enum Status : uint32_t { Pending, Ready, Failed };
+    struct State {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        std::atomic<uint32_t> status{Pending};
+        std::string error;
+        double buildMs = 0.0;
+        TaskCounter done;  // 编译任务完成时归零
+    };
+    std::shared_ptr<State> state;
+};
+
+// 管线注册表的统计
+struct PipelineRegistryStats {
+    uint64_t requests = 0;
+    uint64_t hits = 0;    // 规范化状态和已有的管线相同, 直接返回已有的管线
+    uint64_t misses = 0;  // 新编译的管线
+    uint32_t renderPassClasses = 0;  // 已登记的渲染流程分成的兼容类数
+};
+
+// 管线编译服务: 把管线描述作为任务提交给调度器, 在多个线程上并行编译 (vkCreateGraphicsPipelines 允许多线程同时调用,
+//   管线缓存对象是内部同步的)。渲染器每帧轮询 PipelineFuture, 管线还没编译好的绘制由调用方决定退回到其它管线或跳过。
+//   编译服务拥有它创建的所有管线, 析构时等待未完成的编译并销毁全部管线。
+//
+//   编译服务同时是一个去重的管线注册表: 请求的描述先被规范化 (去掉不起作用的状态, 例如关闭混合时的混合因子),
+//   和着色器字节码的哈希、变体键、渲染流程的兼容类一起组成键。键相同的请求返回同一个管线, 不会重复编译。
+class PipelineBuilder {
+public:
+    PipelineBuilder(VkDevice device, TaskScheduler& scheduler, VkPipelineCache cache);
+    ~PipelineBuilder();
+
+    PipelineBuilder(const PipelineBuilder&) = delete;
+    PipelineBuilder& operator=(const PipelineBuilder&) = delete;
+
+    // 登记渲染流程。除了图像布局和加载/存储操作以外都相同的渲染流程是兼容的, 归为同一类:
+    //   为其中任意一个创建的管线可以用于同一类的所有渲染流程。没有登记的渲染流程只和自己兼容
+    void registerRenderPass(VkRenderPass renderPass, const VkRenderPassCreateInfo& info);
+    bool isCompatible(VkRenderPass a, VkRenderPass b) const;
+
+    // 请求一个管线, 立即返回。注册表中已有相同状态的管线时返回它 (可能还在编译), 否则提交编译
+    PipelineFuture request(const GraphicsPipelineDesc& desc);
+    // 等待一个管线编译完成 (等待期间当前线程也参与编译)。编译失败时抛出异常
+    VkPipeline wait(const PipelineFuture& future);
+    // 等待所有已提交的编译完成
+    void waitAll();
+    // 从注册表中移除并销毁一个管线 (还在编译时先等待编译结束), 之后相同状态的请求重新编译。
+    //   调用方保证已经没有指令缓冲在使用它; 释放后这个 future 的所有副本都不能再使用。重复释放不做任何事
+    void release(const PipelineFuture& future);
+
+    uint32_t pendingCount() const { return pending.load(std::memory_order_acquire); }
+    uint32_t builtCount() const;
+    double totalBuildMs() const;  // 所有已完成编译的耗时之和 (各线程的耗时相加, 不是墙钟时间)
+    PipelineRegistryStats stats() const;
+
+private:
+    std::string stateKey(const GraphicsPipelineDesc& desc) const;
+
+    VkDevice device;
+    TaskScheduler& scheduler;
+    VkPipelineCache cache;
+
+    std::atomic<uint32_t> pending{0};
+
+    mutable std::mutex mutex;
+    std::vector<std::shared_ptr<PipelineFuture::State>> builds;
+    std::unordered_map<std::string, PipelineFuture> registry;       // 规范化的状态键 -> 管线
+    std::unordered_map<std::string, uint32_t> renderPassClassIds;   // 渲染流程的兼容键 -> 兼容类
+    std::unordered_map<VkRenderPass, uint32_t> renderPassClasses;   // 已登记的渲染流程 -> 兼容类
+    PipelineRegistryStats registryStats;
+};
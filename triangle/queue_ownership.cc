@@ -0,0 +1,134 @@
+#include "queue_ownership.h"
+
+#include <vector>
+
+// 释放屏障的目标访问和获取屏障的源访问都会被忽略 (可见性由获取屏障负责), 按规范设为 0
+static VkBufferMemoryBarrier bufferBarrier(const BufferOwnershipTransfer& transfer, bool release) {
+    bool sameFamily = transfer.srcQueueFamily == transfer.dstQueueFamily;
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = release ? transfer.srcAccessMask : 0;
+    barrier.dstAccessMask = !release || sameFamily ? transfer.dstAccessMask : 0;
+    barrier.srcQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : transfer.srcQueueFamily;
+    barrier.dstQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : transfer.dstQueueFamily;
+    barrier.buffer = transfer.buffer;
+    barrier.offset = transfer.offset;
+    barrier.size = transfer.size;
+    return barrier;
+}
+
+static VkImageMemoryBarrier imageBarrier(const ImageOwnershipTransfer& transfer, bool release) {
+    bool sameFamily = transfer.srcQueueFamily == transfer.dstQueueFamily;
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = release ? transfer.srcAccessMask : 0;
+    barrier.dstAccessMask = !release || sameFamily ? transfer.dstAccessMask : 0;
+    barrier.oldLayout = transfer.oldLayout;
+    barrier.newLayout = transfer.newLayout;
+    barrier.srcQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : transfer.srcQueueFamily;
+    barrier.dstQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : transfer.dstQueueFamily;
+    barrier.image = transfer.image;
+    barrier.subresourceRange = transfer.subresourceRange;
+    return barrier;
+}
+
+// 释放屏障只需要等待原队列上的访问, 目标阶段用 BOTTOM_OF_PIPE (不阻塞之后的指令, 之后由信号量的通知保证顺序);
+//   获取屏障的源阶段和目标阶段都用 dstStageMask, 这样它和等待阶段相同的信号量等待构成依赖链。队列族相同时是一个普通的屏障
+template <typename Transfer>
+static void stageMasks(const Transfer* transfers, uint32_t count, bool release, bool crossFamilyOnly,
+                       VkPipelineStageFlags& srcStages, VkPipelineStageFlags& dstStages, uint32_t& recorded) {
+    srcStages = 0;
+    dstStages = 0;
+    recorded = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        bool sameFamily = transfers[i].srcQueueFamily == transfers[i].dstQueueFamily;
+        if (crossFamilyOnly && sameFamily) {
+            continue;
+        }
+        if (release) {
+            srcStages |= transfers[i].srcStageMask;
+            dstStages |= sameFamily ? transfers[i].dstStageMask : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        } else {
+            srcStages |= transfers[i].dstStageMask;
+            dstStages |= transfers[i].dstStageMask;
+        }
+        recorded++;
+    }
+}
+
+void recordRelease(VkCommandBuffer commandBuffer, const BufferOwnershipTransfer* transfers, uint32_t count) {
+    VkPipelineStageFlags srcStages, dstStages;
+    uint32_t recorded;
+    stageMasks(transfers, count, true, false, srcStages, dstStages, recorded);
+    if (recorded == 0) {
+        return;
+    }
+    std::vector<VkBufferMemoryBarrier> barriers;
+    barriers.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        barriers.push_back(bufferBarrier(transfers[i], true));
+    }
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0,
+                         nullptr);
+}
+
+void recordRelease(VkCommandBuffer commandBuffer, const ImageOwnershipTransfer* transfers, uint32_t count) {
+    VkPipelineStageFlags srcStages, dstStages;
+    uint32_t recorded;
+    stageMasks(transfers, count, true, false, srcStages, dstStages, recorded);
+    if (recorded == 0) {
+        return;
+    }
+    std::vector<VkImageMemoryBarrier> barriers;
+    barriers.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        barriers.push_back(imageBarrier(transfers[i], true));
+    }
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()),
+                         barriers.data());
+}
+
+void recordAcquire(VkCommandBuffer commandBuffer, const BufferOwnershipTransfer* transfers, uint32_t count) {
+    VkPipelineStageFlags srcStages, dstStages;
+    uint32_t recorded;
+    stageMasks(transfers, count, false, true, srcStages, dstStages, recorded);
+    if (recorded == 0) {
+        return;
+    }
+    std::vector<VkBufferMemoryBarrier> barriers;
+    barriers.reserve(recorded);
+    for (uint32_t i = 0; i < count; i++) {
+        if (transfers[i].srcQueueFamily != transfers[i].dstQueueFamily) {
+            barriers.push_back(bufferBarrier(transfers[i], false));
+        }
+    }
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0,
+                         nullptr);
+}
+
+void recordAcquire(VkCommandBuffer commandBuffer, const ImageOwnershipTransfer* transfers, uint32_t count) {
+    VkPipelineStageFlags srcStages, dstStages;
+    uint32_t recorded;
+    stageMasks(transfers, count, false, true, srcStages, dstStages, recorded);
+    if (recorded == 0) {
+        return;
+    }
+    std::vector<VkImageMemoryBarrier> barriers;
+    barriers.reserve(recorded);
+    for (uint32_t i = 0; i < count; i++) {
+        if (transfers[i].srcQueueFamily != transfers[i].dstQueueFamily) {
+            barriers.push_back(imageBarrier(transfers[i], false));
+        }
+    }
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()),
+                         barriers.data());
+}
+
+bool needsAcquire(const BufferOwnershipTransfer* transfers, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (transfers[i].srcQueueFamily != transfers[i].dstQueueFamily) {
+            return true;
+        }
+    }
+    return false;
+}
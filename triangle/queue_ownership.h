@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// 资源在队列族之间的所有权转移。EXCLUSIVE 模式的资源被另一个队列族使用之前, 要在原队列族的队列上录制释放屏障,
+//   在新队列族的队列上录制获取屏障, 两次提交之间用信号量 (例如 QueueTimeline::waitFor) 保证先后顺序。
+//   获取提交的信号量等待阶段需要包含 dstStageMask。
+//   两个队列族相同时不需要转移, 释放操作录制一个普通的屏障 (src -> dst), 获取操作什么也不做。
+struct BufferOwnershipTransfer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = VK_WHOLE_SIZE;
+    uint32_t srcQueueFamily = 0;
+    uint32_t dstQueueFamily = 0;
+    VkPipelineStageFlags srcStageMask = 0;  // 原队列上最后一次访问的阶段和类型
+    VkAccessFlags srcAccessMask = 0;
+    VkPipelineStageFlags dstStageMask = 0;  // 新队列上第一次访问的阶段和类型
+    VkAccessFlags dstAccessMask = 0;
+};
+
+// 图像的转移可以同时转换布局 (释放和获取屏障中的布局必须相同, 转换只执行一次)
+struct ImageOwnershipTransfer {
+    VkImage image = VK_NULL_HANDLE;
+    VkImageSubresourceRange subresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+    VkImageLayout oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImageLayout newLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    uint32_t srcQueueFamily = 0;
+    uint32_t dstQueueFamily = 0;
+    VkPipelineStageFlags srcStageMask = 0;
+    VkAccessFlags srcAccessMask = 0;
+    VkPipelineStageFlags dstStageMask = 0;
+    VkAccessFlags dstAccessMask = 0;
+};
+
+// 在原队列族的指令缓冲中录制释放屏障
+void recordRelease(VkCommandBuffer commandBuffer, const BufferOwnershipTransfer* transfers, uint32_t count);
+void recordRelease(VkCommandBuffer commandBuffer, const ImageOwnershipTransfer* transfers, uint32_t count);
+// 在新队列族的指令缓冲中录制获取屏障 (队列族相同时不录制任何指令)
+void recordAcquire(VkCommandBuffer commandBuffer, const BufferOwnershipTransfer* transfers, uint32_t count);
+void recordAcquire(VkCommandBuffer commandBuffer, const ImageOwnershipTransfer* transfers, uint32_t count);
+
+// 一组转移中是否有真正跨队列族的转移 (没有时不需要在新队列上录制和提交获取操作)
+bool needsAcquire(const BufferOwnershipTransfer* transfers, uint32_t count);
@@ -0,0 +1,91 @@
+#include "queue_timeline.h"
+
+#include <stdexcept>
+
+QueueTimeline::QueueTimeline(VkDevice device, VkQueue queue) : device(device), submitQueue(queue) {
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timeline semaphore!");
+    }
+}
+
+QueueTimeline::~QueueTimeline() {
+    vkDestroySemaphore(device, timeline, nullptr);
+}
+
+uint64_t QueueTimeline::submit(const VkCommandBuffer* commandBuffers, uint32_t commandBufferCount, const SemaphoreWait* waits,
+                               uint32_t waitCount, VkSemaphore binarySignal) {
+    if (waitCount > MAX_WAITS) {
+        throw std::runtime_error("too many semaphore waits in one submission");
+    }
+    VkSemaphore waitSemaphores[MAX_WAITS];
+    uint64_t waitValues[MAX_WAITS];
+    VkPipelineStageFlags waitStages[MAX_WAITS];
+    for (uint32_t i = 0; i < waitCount; i++) {
+        waitSemaphores[i] = waits[i].semaphore;
+        waitValues[i] = waits[i].value;
+        waitStages[i] = waits[i].stageMask;
+    }
+
+    uint64_t value = submitted + 1;
+    VkSemaphore signalSemaphores[] = {timeline, binarySignal};
+    uint64_t signalValues[] = {value, 0};  // 二值信号量的值被忽略
+    uint32_t signalCount = binarySignal != VK_NULL_HANDLE ? 2 : 1;
+
+    // 时间线信号量的值通过 pNext 传入, 数组和 VkSubmitInfo 中的信号量一一对应
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = waitCount;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+    timelineInfo.signalSemaphoreValueCount = signalCount;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = waitCount;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
+    submitInfo.commandBufferCount = commandBufferCount;
+    submitInfo.pCommandBuffers = commandBuffers;
+    submitInfo.signalSemaphoreCount = signalCount;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+
+    if (vkQueueSubmit(submitQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit command buffer!");
+    }
+    submitted = value;
+    return value;
+}
+
+uint64_t QueueTimeline::completed() {
+    uint64_t value;
+    if (vkGetSemaphoreCounterValue(device, timeline, &value) != VK_SUCCESS) {
+        throw std::runtime_error("failed to query timeline semaphore!");
+    }
+    completedValue = value;
+    return value;
+}
+
+void QueueTimeline::wait(uint64_t value) {
+    if (value <= completedValue) {
+        return;
+    }
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timeline;
+    waitInfo.pValues = &value;
+    if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+        throw std::runtime_error("failed to wait for timeline semaphore!");
+    }
+    completedValue = value;
+}
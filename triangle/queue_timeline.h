@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// 提交时等待的信号量。时间线信号量等待它到达 value; 二值信号量 (交换链的图像获取) 忽略 value
+struct SemaphoreWait {
+    VkSemaphore semaphore;
+    uint64_t value;
+    VkPipelineStageFlags stageMask;  // 等待之前可以先执行的阶段之后的阶段 (同 VkSubmitInfo::pWaitDstStageMask)
+};
+
+// 一个队列的时间线信号量 (Vulkan 1.2): 每次提交把值加一, 提交的指令执行完毕时信号量到达这个值。
+//   (信号量, 值) 标识一次提交, 代替每次提交一个 fence: CPU 用 wait 等待某次提交完成, 其它队列的提交用 waitFor 返回的
+//   SemaphoreWait 在 GPU 上等待它。值只增不减, 不需要像 fence 一样重置, 也不会因为忘记重置而死锁。
+class QueueTimeline {
+public:
+    static const uint32_t MAX_WAITS = 8;  // 一次提交最多等待的信号量数
+
+    QueueTimeline(VkDevice device, VkQueue queue);
+    ~QueueTimeline();
+
+    QueueTimeline(const QueueTimeline&) = delete;
+    QueueTimeline& operator=(const QueueTimeline&) = delete;
+
+    VkQueue queue() const { return submitQueue; }
+    VkSemaphore semaphore() const { return timeline; }
+
+    // 提交指令缓冲, waits 都满足后开始执行, 执行完毕时时间线到达返回的值, 同时通知 binarySignal
+    //   (交换链的呈现只能等待二值信号量, 不需要时为 VK_NULL_HANDLE)。失败时抛出异常
+    uint64_t submit(const VkCommandBuffer* commandBuffers, uint32_t commandBufferCount, const SemaphoreWait* waits = nullptr,
+                    uint32_t waitCount = 0, VkSemaphore binarySignal = VK_NULL_HANDLE);
+
+    // 其它队列等待这个队列上的一次提交
+    SemaphoreWait waitFor(uint64_t value, VkPipelineStageFlags stageMask) const { return {timeline, value, stageMask}; }
+
+    uint64_t lastSubmitted() const { return submitted; }
+    // 已经执行完毕的最大值 (不阻塞)
+    uint64_t completed();
+    bool isComplete(uint64_t value) { return value <= completedValue || value <= completed(); }
+    // 阻塞直到时间线到达 value, 已经到达时不调用驱动
+    void wait(uint64_t value);
+    void waitIdle() { wait(submitted); }
+
+private:
+    VkDevice device;
+    VkQueue submitQueue;
+    VkSemaphore timeline = VK_NULL_HANDLE;
+    uint64_t submitted = 0;
+    uint64_t completedValue = 0;  // 最近一次观察到的完成值
+};
@@ -1,9 +1,22 @@
 #version 450
 
+// 特化常量: 创建管线时由 VkSpecializationInfo 指定 (见 shader_variant.h), 驱动编译时消除用不到的分支
+layout(constant_id = 0) const uint TINT = 0;          // 材质色调的编号, 0 表示不着色
+layout(constant_id = 1) const bool GRAYSCALE = false; // 输出灰度
+
 layout(location = 0) in vec3 fragColor;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
-}
\ No newline at end of file
+    vec3 color = fragColor;
+    if (TINT != 0) {
+        // 色相按黄金分割依次错开, 相邻编号的颜色区别明显
+        float hue = fract(float(TINT) * 0.618034);
+        color *= 0.6 + 0.4 * cos(6.2831853 * (hue + vec3(0.0, 1.0 / 3.0, 2.0 / 3.0)));
+    }
+    if (GRAYSCALE) {
+        color = vec3(dot(color, vec3(0.299, 0.587, 0.114)));
+    }
+    outColor = vec4(color, 1.0);
+}
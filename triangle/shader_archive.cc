@@ -0,0 +1,161 @@
+#include "shader_archive.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+ShaderCode ShaderCode::fromBytes(std::vector<char> bytes) {
+    // std::vector<char> 的数据由 operator new 分配, 对齐满足 uint32_t 的要求
+    auto buffer = std::make_shared<const std::vector<char>>(std::move(bytes));
+    ShaderCode shader;
+    shader.code = reinterpret_cast<const uint32_t*>(buffer->data());
+    shader.size = buffer->size();
+    shader.hash = shaderPackHash(buffer->data(), buffer->size());
+    shader.owner = buffer;
+    return shader;
+}
+
+std::shared_ptr<ShaderArchive> ShaderArchive::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open shader archive " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShaderPackHeader)) {
+        close(fd);
+        throw std::runtime_error("invalid shader archive " + path);
+    }
+
+    std::shared_ptr<ShaderArchive> archive(new ShaderArchive());
+    archive->mappedSize = static_cast<size_t>(st.st_size);
+    archive->mapped = mmap(nullptr, archive->mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // 映射建立后文件描述符不再需要
+    if (archive->mapped == MAP_FAILED) {
+        archive->mapped = nullptr;
+        throw std::runtime_error("failed to map shader archive " + path);
+    }
+
+    // 校验头部和所有条目的范围, 之后的查找不再检查
+    const char* base = static_cast<const char*>(archive->mapped);
+    archive->header = reinterpret_cast<const ShaderPackHeader*>(base);
+    archive->entries = reinterpret_cast<const ShaderPackEntry*>(base + sizeof(ShaderPackHeader));
+    const ShaderPackHeader& header = *archive->header;
+    if (memcmp(header.magic, SHADER_PACK_MAGIC, sizeof(header.magic)) != 0 || header.version != SHADER_PACK_VERSION ||
+        header.fileSize != archive->mappedSize ||
+        sizeof(ShaderPackHeader) + static_cast<uint64_t>(header.entryCount) * sizeof(ShaderPackEntry) > archive->mappedSize) {
+        throw std::runtime_error("invalid shader archive " + path);
+    }
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        const ShaderPackEntry& entry = archive->entries[i];
+        if (static_cast<uint64_t>(entry.nameOffset) + entry.nameSize > archive->mappedSize ||
+            entry.dataOffset + entry.dataSize > archive->mappedSize || entry.dataOffset % 4 != 0 || entry.dataSize % 4 != 0 ||
+            (i > 0 && archive->entryName(i - 1) >= archive->entryName(i))) {
+            throw std::runtime_error("invalid shader archive " + path + " (entry " + std::to_string(i) + ")");
+        }
+    }
+    return archive;
+}
+
+ShaderArchive::~ShaderArchive() {
+    if (mapped) {
+        munmap(mapped, mappedSize);
+    }
+}
+
+std::string_view ShaderArchive::entryName(uint32_t index) const {
+    const ShaderPackEntry& entry = entries[index];
+    return std::string_view(static_cast<const char*>(mapped) + entry.nameOffset, entry.nameSize);
+}
+
+ShaderCode ShaderArchive::find(std::string_view name) const {
+    uint32_t begin = 0;
+    uint32_t end = header->entryCount;
+    while (begin < end) {
+        uint32_t middle = begin + (end - begin) / 2;
+        std::string_view middleName = entryName(middle);
+        if (middleName == name) {
+            const ShaderPackEntry& entry = entries[middle];
+            ShaderCode shader;
+            shader.code = reinterpret_cast<const uint32_t*>(static_cast<const char*>(mapped) + entry.dataOffset);
+            shader.size = entry.dataSize;
+            shader.hash = entry.hash;
+            shader.owner = shared_from_this();
+            return shader;
+        }
+        if (middleName < name) {
+            begin = middle + 1;
+        } else {
+            end = middle;
+        }
+    }
+    return ShaderCode();
+}
+
+void writeShaderArchive(const std::string& path, std::vector<std::pair<std::string, std::vector<char>>> inputs) {
+    std::sort(inputs.begin(), inputs.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    // 读取时按名字二分查找, 要求名字严格递增
+    for (size_t i = 1; i < inputs.size(); i++) {
+        if (inputs[i].first == inputs[i - 1].first) {
+            throw std::runtime_error("duplicate shader name " + inputs[i].first + " in archive");
+        }
+    }
+
+    // 计算布局: 头部、条目表、名字, 然后是对齐的数据
+    std::vector<ShaderPackEntry> entries(inputs.size());
+    uint64_t offset = sizeof(ShaderPackHeader) + sizeof(ShaderPackEntry) * inputs.size();
+    for (size_t i = 0; i < inputs.size(); i++) {
+        entries[i].nameOffset = static_cast<uint32_t>(offset);
+        entries[i].nameSize = static_cast<uint32_t>(inputs[i].first.size());
+        offset += inputs[i].first.size();
+    }
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (inputs[i].second.size() % 4 != 0) {
+            throw std::runtime_error("SPIR-V size of " + inputs[i].first + " is not a multiple of 4");
+        }
+        offset = alignUp(offset, SHADER_PACK_ALIGNMENT);
+        entries[i].dataOffset = offset;
+        entries[i].dataSize = inputs[i].second.size();
+        entries[i].hash = shaderPackHash(inputs[i].second.data(), inputs[i].second.size());
+        offset += inputs[i].second.size();
+    }
+
+    ShaderPackHeader header{};
+    memcpy(header.magic, SHADER_PACK_MAGIC, sizeof(header.magic));
+    header.version = SHADER_PACK_VERSION;
+    header.entryCount = static_cast<uint32_t>(inputs.size());
+    header.fileSize = offset;
+
+    std::vector<char> pack(offset, 0);
+    memcpy(pack.data(), &header, sizeof(header));
+    if (!entries.empty()) {
+        memcpy(pack.data() + sizeof(header), entries.data(), sizeof(ShaderPackEntry) * entries.size());
+    }
+    for (size_t i = 0; i < inputs.size(); i++) {
+        memcpy(pack.data() + entries[i].nameOffset, inputs[i].first.data(), inputs[i].first.size());
+        memcpy(pack.data() + entries[i].dataOffset, inputs[i].second.data(), inputs[i].second.size());
+    }
+
+    // 先写临时文件再改名, 写入中断时不会留下不完整的归档 (已经映射旧归档的进程也不受影响)
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write(pack.data(), pack.size());
+        if (!file) {
+            throw std::runtime_error("failed to write " + tmpPath);
+        }
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("failed to rename " + tmpPath);
+    }
+}
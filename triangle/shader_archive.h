@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "shader_pack_format.h"
+
+// 一段 SPIR-V 字节码: 字节码的指针和长度, 以及保证它有效的所有者 (映射的归档, 或者单独保存字节码的缓冲)。
+//   复制 ShaderCode 不会复制字节码; hash 预先计算好, 用作着色器的标识 (例如管线注册表的键)。
+struct ShaderCode {
+    const uint32_t* code = nullptr;
+    size_t size = 0;    // 字节数
+    uint64_t hash = 0;  // 字节码的 FNV-1a 哈希
+    std::shared_ptr<const void> owner;
+
+    explicit operator bool() const { return code != nullptr; }
+
+    // 接管一段单独加载的字节码 (例如热重载时新编译的着色器)
+    static ShaderCode fromBytes(std::vector<char> bytes);
+};
+
+// 只读的着色器归档 (.spvpack, 格式见 shader_pack_format.h)。
+//   整个文件映射到内存, find 返回直接指向映射内容的 ShaderCode, 可以直接作为 VkShaderModuleCreateInfo::pCode 使用,
+//   不复制也不分配内存。返回的 ShaderCode 持有归档的引用, 归档在最后一个引用释放后才解除映射。
+class ShaderArchive : public std::enable_shared_from_this<ShaderArchive> {
+public:
+    // 映射并校验归档, 失败时抛出异常
+    static std::shared_ptr<ShaderArchive> open(const std::string& path);
+    ~ShaderArchive();
+
+    ShaderArchive(const ShaderArchive&) = delete;
+    ShaderArchive& operator=(const ShaderArchive&) = delete;
+
+    // 按名字查找 (二分查找), 没有时返回空的 ShaderCode
+    ShaderCode find(std::string_view name) const;
+
+    uint32_t entryCount() const { return header->entryCount; }
+    std::string_view entryName(uint32_t index) const;
+    size_t mappedBytes() const { return mappedSize; }
+
+private:
+    ShaderArchive() = default;
+
+    void* mapped = nullptr;
+    size_t mappedSize = 0;
+    const ShaderPackHeader* header = nullptr;
+    const ShaderPackEntry* entries = nullptr;
+};
+
+// 把若干个 (名字, SPIR-V) 写成一个归档, 失败 (包括名字重复) 时抛出异常。构建时的 shader_pack 工具和加载测试都使用它
+void writeShaderArchive(const std::string& path, std::vector<std::pair<std::string, std::vector<char>>> inputs);
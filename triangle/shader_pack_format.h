@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// .spvpack 文件格式: 一个目标的所有 SPIR-V 打包成的单个文件, 由构建时的 shader_pack 工具生成, 运行时可以直接映射到内存使用。
+//   [ShaderPackHeader][ShaderPackEntry * entryCount][名字 (不以 0 结尾)][SPIR-V 数据, 每段对齐到 SHADER_PACK_ALIGNMENT]
+//   所有整数为小端序, 偏移都相对于文件开头; 条目按名字排序, 可以二分查找。
+
+static const char SHADER_PACK_MAGIC[8] = {'S', 'P', 'V', 'P', 'A', 'C', 'K', '\0'};
+static const uint32_t SHADER_PACK_VERSION = 1;
+static const uint64_t SHADER_PACK_ALIGNMENT = 16;
+
+struct ShaderPackHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entryCount;
+    uint64_t fileSize;
+};
+
+struct ShaderPackEntry {
+    uint32_t nameOffset;
+    uint32_t nameSize;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+    uint64_t hash;  // 数据的 FNV-1a 哈希, 用于校验和作为着色器的标识
+};
+
+static_assert(sizeof(ShaderPackHeader) == 24, "unexpected ShaderPackHeader layout");
+static_assert(sizeof(ShaderPackEntry) == 32, "unexpected ShaderPackEntry layout");
+
+inline uint64_t shaderPackHash(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
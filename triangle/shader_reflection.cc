@@ -0,0 +1,301 @@
+#include "shader_reflection.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+// 用到的 SPIR-V 指令和枚举值 (见 SPIR-V 规范 3.x 节), 不依赖 spirv.h
+static const uint32_t SPIRV_MAGIC = 0x07230203;
+static const uint32_t SPIRV_HEADER_WORDS = 5;
+
+enum SpvOp : uint32_t {
+    OpName = 5,
+    OpEntryPoint = 15,
+    OpExecutionMode = 16,
+    OpTypeInt = 21,
+    OpTypeFloat = 22,
+    OpTypeVector = 23,
+    OpTypeMatrix = 24,
+    OpTypeImage = 25,
+    OpTypeSampler = 26,
+    OpTypeSampledImage = 27,
+    OpTypeArray = 28,
+    OpTypeRuntimeArray = 29,
+    OpTypeStruct = 30,
+    OpTypePointer = 32,
+    OpConstant = 43,
+    OpVariable = 59,
+    OpDecorate = 71,
+    OpMemberDecorate = 72,
+};
+
+enum SpvDecoration : uint32_t {
+    DecorationBlock = 2,
+    DecorationBufferBlock = 3,
+    DecorationArrayStride = 6,
+    DecorationMatrixStride = 7,
+    DecorationBinding = 33,
+    DecorationDescriptorSet = 34,
+    DecorationOffset = 35,
+};
+
+enum SpvStorageClass : uint32_t {
+    StorageClassUniformConstant = 0,
+    StorageClassUniform = 2,
+    StorageClassPushConstant = 9,
+    StorageClassStorageBuffer = 12,
+};
+
+static const uint32_t ExecutionModeLocalSize = 17;
+static const uint32_t DimBuffer = 5;
+static const uint32_t DimSubpassData = 6;
+
+// 解析过程中记录的一个 id: 类型的操作数、变量的存储类别和装饰
+struct SpvId {
+    uint32_t op = 0;
+    std::vector<uint32_t> operands;  // 去掉结果 id 之后的操作数
+    std::string name;
+    bool block = false;
+    bool bufferBlock = false;
+    uint32_t set = 0;
+    uint32_t binding = 0;
+    bool hasBinding = false;
+    uint32_t arrayStride = 0;
+    std::vector<uint32_t> memberOffsets;
+    std::vector<uint32_t> memberMatrixStrides;
+};
+
+static VkShaderStageFlagBits executionModelStage(uint32_t model) {
+    switch (model) {
+    case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+    case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+    default: throw std::runtime_error("unsupported SPIR-V execution model " + std::to_string(model));
+    }
+}
+
+static std::string literalString(const uint32_t* words, size_t count) {
+    const char* text = reinterpret_cast<const char*>(words);
+    size_t length = 0;
+    while (length < count * 4 && text[length] != '\0') {
+        length++;
+    }
+    return std::string(text, length);
+}
+
+static void resizeMembers(SpvId& id, uint32_t member) {
+    if (id.memberOffsets.size() <= member) {
+        id.memberOffsets.resize(member + 1, 0);
+        id.memberMatrixStrides.resize(member + 1, 0);
+    }
+}
+
+// 类型在块中占用的字节数 (按显式布局的 Offset/ArrayStride/MatrixStride 计算)
+static uint32_t typeSize(std::unordered_map<uint32_t, SpvId>& ids, uint32_t typeId, uint32_t matrixStride) {
+    SpvId& type = ids[typeId];
+    switch (type.op) {
+    case OpTypeInt:
+    case OpTypeFloat:
+        return type.operands[0] / 8;
+    case OpTypeVector:
+        return type.operands[1] * typeSize(ids, type.operands[0], 0);
+    case OpTypeMatrix:
+        return type.operands[1] * (matrixStride > 0 ? matrixStride : typeSize(ids, type.operands[0], 0));
+    case OpTypeArray: {
+        SpvId& length = ids[type.operands[1]];
+        uint32_t stride = type.arrayStride > 0 ? type.arrayStride : typeSize(ids, type.operands[0], matrixStride);
+        return length.op == OpConstant ? length.operands[1] * stride : 0;
+    }
+    case OpTypeStruct: {
+        uint32_t size = 0;
+        for (uint32_t m = 0; m < type.operands.size(); m++) {
+            resizeMembers(type, m);
+            uint32_t offset = type.memberOffsets[m];
+            uint32_t stride = type.memberMatrixStrides[m];
+            size = std::max(size, offset + typeSize(ids, type.operands[m], stride));
+        }
+        return size;
+    }
+    default:
+        return 0;  // 不定长数组等, 不占固定大小
+    }
+}
+
+static VkDescriptorType descriptorType(std::unordered_map<uint32_t, SpvId>& ids, uint32_t storageClass, uint32_t typeId) {
+    SpvId& type = ids[typeId];
+    if (storageClass == StorageClassStorageBuffer) {
+        return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    }
+    if (storageClass == StorageClassUniform) {
+        // 旧的 SPIR-V (1.3 之前) 用 Uniform + BufferBlock 表示存储缓冲
+        return type.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    }
+    switch (type.op) {
+    case OpTypeSampler:
+        return VK_DESCRIPTOR_TYPE_SAMPLER;
+    case OpTypeSampledImage:
+        return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    case OpTypeImage: {
+        uint32_t dim = type.operands[1];
+        uint32_t sampled = type.operands[5];  // 1: 和采样器一起使用, 2: 存储图像
+        if (dim == DimBuffer) {
+            return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        }
+        if (dim == DimSubpassData) {
+            return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        }
+        return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    }
+    default:
+        throw std::runtime_error("unsupported SPIR-V descriptor type (opcode " + std::to_string(type.op) + ")");
+    }
+}
+
+ShaderReflection reflectShader(const ShaderCode& shader) {
+    const uint32_t* words = shader.code;
+    size_t wordCount = shader.size / 4;
+    if (wordCount < SPIRV_HEADER_WORDS || words[0] != SPIRV_MAGIC) {
+        throw std::runtime_error("invalid SPIR-V (bad header)");
+    }
+
+    ShaderReflection reflection;
+    std::unordered_map<uint32_t, SpvId> ids;
+    std::vector<uint32_t> variables;
+    uint32_t entryPointId = 0;
+    bool hasEntryPoint = false;
+
+    for (size_t i = SPIRV_HEADER_WORDS; i < wordCount; ) {
+        uint32_t count = words[i] >> 16;
+        uint32_t op = words[i] & 0xffff;
+        if (count == 0 || i + count > wordCount) {
+            throw std::runtime_error("invalid SPIR-V (truncated instruction at word " + std::to_string(i) + ")");
+        }
+        const uint32_t* operands = words + i + 1;
+        uint32_t operandCount = count - 1;
+
+        switch (op) {
+        case OpName:
+            if (operandCount >= 1) {
+                ids[operands[0]].name = literalString(operands + 1, operandCount - 1);
+            }
+            break;
+        case OpEntryPoint:
+            if (!hasEntryPoint && operandCount >= 3) {
+                reflection.stage = executionModelStage(operands[0]);
+                entryPointId = operands[1];
+                reflection.entryPoint = literalString(operands + 2, operandCount - 2);
+                hasEntryPoint = true;
+            }
+            break;
+        case OpExecutionMode:
+            if (hasEntryPoint && operandCount >= 5 && operands[0] == entryPointId && operands[1] == ExecutionModeLocalSize) {
+                reflection.localSize[0] = operands[2];
+                reflection.localSize[1] = operands[3];
+                reflection.localSize[2] = operands[4];
+            }
+            break;
+        case OpTypeInt:
+        case OpTypeFloat:
+        case OpTypeVector:
+        case OpTypeMatrix:
+        case OpTypeImage:
+        case OpTypeSampler:
+        case OpTypeSampledImage:
+        case OpTypeArray:
+        case OpTypeRuntimeArray:
+        case OpTypeStruct:
+        case OpTypePointer:
+            if (operandCount >= 1) {
+                SpvId& id = ids[operands[0]];
+                id.op = op;
+                id.operands.assign(operands + 1, operands + operandCount);
+            }
+            break;
+        case OpConstant:  // 结果类型, 结果 id, 值
+        case OpVariable:  // 结果类型, 结果 id, 存储类别
+            if (operandCount >= 3) {
+                SpvId& id = ids[operands[1]];
+                id.op = op;
+                id.operands = {operands[0], operands[2]};
+                if (op == OpVariable) {
+                    variables.push_back(operands[1]);
+                }
+            }
+            break;
+        case OpDecorate:
+            if (operandCount >= 2) {
+                SpvId& id = ids[operands[0]];
+                switch (operands[1]) {
+                case DecorationBlock: id.block = true; break;
+                case DecorationBufferBlock: id.bufferBlock = true; break;
+                case DecorationArrayStride: id.arrayStride = operandCount >= 3 ? operands[2] : 0; break;
+                case DecorationBinding: id.binding = operandCount >= 3 ? operands[2] : 0; id.hasBinding = true; break;
+                case DecorationDescriptorSet: id.set = operandCount >= 3 ? operands[2] : 0; break;
+                }
+            }
+            break;
+        case OpMemberDecorate:
+            if (operandCount >= 4) {
+                SpvId& id = ids[operands[0]];
+                resizeMembers(id, operands[1]);
+                if (operands[2] == DecorationOffset) {
+                    id.memberOffsets[operands[1]] = operands[3];
+                } else if (operands[2] == DecorationMatrixStride) {
+                    id.memberMatrixStrides[operands[1]] = operands[3];
+                }
+            }
+            break;
+        }
+        i += count;
+    }
+    if (!hasEntryPoint) {
+        throw std::runtime_error("invalid SPIR-V (no entry point)");
+    }
+
+    for (uint32_t variableId : variables) {
+        SpvId variable = ids[variableId];
+        uint32_t storageClass = variable.operands[1];
+        SpvId& pointer = ids[variable.operands[0]];
+        if (pointer.op != OpTypePointer || pointer.operands.size() < 2) {
+            throw std::runtime_error("invalid SPIR-V (variable " + variable.name + " is not a pointer)");
+        }
+        uint32_t typeId = pointer.operands[1];
+
+        if (storageClass == StorageClassPushConstant) {
+            reflection.pushConstantSize = std::max(reflection.pushConstantSize, typeSize(ids, typeId, 0));
+            continue;
+        }
+        if (storageClass != StorageClassUniform && storageClass != StorageClassUniformConstant &&
+            storageClass != StorageClassStorageBuffer) {
+            continue;  // 输入输出、工作组共享变量等不是描述符
+        }
+        if (!variable.hasBinding) {
+            continue;
+        }
+
+        ShaderBinding binding;
+        binding.set = variable.set;
+        binding.binding = variable.binding;
+        binding.name = variable.name.empty() ? ids[typeId].name : variable.name;
+        if (ids[typeId].op == OpTypeArray) {
+            SpvId& length = ids[ids[typeId].operands[1]];
+            if (length.op != OpConstant) {
+                throw std::runtime_error("descriptor array " + binding.name + " has a specialization-constant length");
+            }
+            binding.count = length.operands[1];
+            typeId = ids[typeId].operands[0];
+        } else if (ids[typeId].op == OpTypeRuntimeArray) {
+            throw std::runtime_error("unsized descriptor array " + binding.name + " is not supported");
+        }
+        binding.type = descriptorType(ids, storageClass, typeId);
+        reflection.bindings.push_back(binding);
+    }
+
+    std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const ShaderBinding& a, const ShaderBinding& b) {
+        return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+    });
+    return reflection;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "shader_archive.h"
+
+// 着色器声明的一个描述符绑定
+struct ShaderBinding {
+    uint32_t set = 0;
+    uint32_t binding = 0;
+    VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uint32_t count = 1;  // 描述符数组的长度
+    std::string name;    // 变量名, 匿名的块使用块的类型名
+};
+
+// 从 SPIR-V 字节码中反射出的接口: 创建描述符集布局和管线布局需要的信息。
+//   只读取第一个入口点; 计算着色器的工作组大小只支持字面值 (local_size_x = N), 用特化常量指定时保持为 1。
+//   uniform 缓冲是否使用动态偏移无法从字节码中得到, 由调用方决定
+struct ShaderReflection {
+    VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+    std::string entryPoint;
+    uint32_t localSize[3] = {1, 1, 1};
+    std::vector<ShaderBinding> bindings;  // 按 (set, binding) 排序
+    uint32_t pushConstantSize = 0;        // push constant 块的字节数, 0 表示没有
+};
+
+// 解析字节码, 格式错误或使用了不支持的描述符 (例如不定长的描述符数组) 时抛出异常
+ShaderReflection reflectShader(const ShaderCode& shader);
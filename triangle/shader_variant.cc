@@ -0,0 +1,84 @@
+#include "shader_variant.h"
+
+#include <stdexcept>
+
+ShaderVariants& ShaderVariants::toggle(const std::string& name, uint32_t constantId, bool defaultValue) {
+    return declare(name, constantId, true, 1, defaultValue ? 1 : 0);
+}
+
+ShaderVariants& ShaderVariants::constant(const std::string& name, uint32_t constantId, uint32_t bits, uint32_t defaultValue) {
+    return declare(name, constantId, false, bits, defaultValue);
+}
+
+ShaderVariants& ShaderVariants::declare(const std::string& name, uint32_t constantId, bool isBool, uint32_t bits, uint32_t defaultValue) {
+    if (has(name)) {
+        throw std::runtime_error("shader variant constant declared twice: " + name);
+    }
+    if (bits == 0 || bits > 32 || usedBits + bits > 64 || constants.size() >= ShaderSpecialization::MAX_CONSTANTS) {
+        throw std::runtime_error("too many shader variant constants (at most 64 key bits and "
+                                 + std::to_string(ShaderSpecialization::MAX_CONSTANTS) + " constants)");
+    }
+    if (bits < 32 && defaultValue >> bits != 0) {
+        throw std::runtime_error("default value of " + name + " does not fit in " + std::to_string(bits) + " bits");
+    }
+    constants.push_back({name, constantId, isBool, bits, usedBits, defaultValue});
+    usedBits += bits;
+    return *this;
+}
+
+bool ShaderVariants::has(const std::string& name) const {
+    for (const Constant& constant : constants) {
+        if (constant.name == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const ShaderVariants::Constant& ShaderVariants::find(const std::string& name) const {
+    for (const Constant& constant : constants) {
+        if (constant.name == name) {
+            return constant;
+        }
+    }
+    throw std::runtime_error("unknown shader variant constant: " + name);
+}
+
+uint64_t ShaderVariants::defaultKey() const {
+    uint64_t key = 0;
+    for (const Constant& constant : constants) {
+        key |= static_cast<uint64_t>(constant.defaultValue) << constant.shift;
+    }
+    return key;
+}
+
+uint64_t ShaderVariants::set(uint64_t key, const std::string& name, uint32_t value) const {
+    const Constant& constant = find(name);
+    if (constant.bits < 32 && value >> constant.bits != 0) {
+        throw std::runtime_error("value " + std::to_string(value) + " of " + name + " does not fit in "
+                                 + std::to_string(constant.bits) + " bits");
+    }
+    uint64_t mask = ((uint64_t(1) << constant.bits) - 1) << constant.shift;
+    return (key & ~mask) | (static_cast<uint64_t>(value) << constant.shift);
+}
+
+uint32_t ShaderVariants::get(uint64_t key, const std::string& name) const {
+    const Constant& constant = find(name);
+    return static_cast<uint32_t>((key >> constant.shift) & ((uint64_t(1) << constant.bits) - 1));
+}
+
+void ShaderVariants::specialize(uint64_t key, ShaderSpecialization& specialization) const {
+    uint32_t count = static_cast<uint32_t>(constants.size());
+    for (uint32_t i = 0; i < count; i++) {
+        const Constant& constant = constants[i];
+        uint32_t value = static_cast<uint32_t>((key >> constant.shift) & ((uint64_t(1) << constant.bits) - 1));
+        specialization.data[i] = constant.isBool ? (value ? VK_TRUE : VK_FALSE) : value;
+        specialization.entries[i].constantID = constant.constantId;
+        specialization.entries[i].offset = i * sizeof(uint32_t);
+        specialization.entries[i].size = sizeof(uint32_t);
+    }
+    specialization.specializationInfo.mapEntryCount = count;
+    specialization.specializationInfo.pMapEntries = specialization.entries;
+    specialization.specializationInfo.dataSize = count * sizeof(uint32_t);
+    specialization.specializationInfo.pData = specialization.data;
+}
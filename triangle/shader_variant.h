@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 一组特化常量的值, 可以直接作为 VkPipelineShaderStageCreateInfo::pSpecializationInfo 使用 (固定容量, 不分配内存)。
+//   specializationInfo 指向对象自己的 entries / data, 复制或移动后会指向原来的对象, 所以禁止复制和移动
+struct ShaderSpecialization {
+    static const uint32_t MAX_CONSTANTS = 16;
+
+    ShaderSpecialization() = default;
+    ShaderSpecialization(const ShaderSpecialization&) = delete;
+    ShaderSpecialization& operator=(const ShaderSpecialization&) = delete;
+
+    VkSpecializationMapEntry entries[MAX_CONSTANTS];
+    uint32_t data[MAX_CONSTANTS];  // bool 常量按 VkBool32 保存, 所以每个常量都是 4 字节
+    VkSpecializationInfo specializationInfo{};
+
+    // 没有特化常量时返回 nullptr
+    const VkSpecializationInfo* info() const { return specializationInfo.mapEntryCount > 0 ? &specializationInfo : nullptr; }
+};
+
+// 一个着色器的变体声明: 着色器中的开关和常量都声明为特化常量 (layout(constant_id = N) const ...),
+//   同一个 SPIR-V 模块在创建管线时通过 VkSpecializationInfo 指定具体的值, 驱动编译时会消除用不到的分支,
+//   所以不需要为每种组合预先编译一份 SPIR-V。
+//
+//   所有常量的值打包成一个 64 位的变体键 (开关占 1 位, 常量占声明的位数), 键和着色器一起组成管线的标识,
+//   管线注册表按它缓存管线。
+class ShaderVariants {
+public:
+    // 声明一个开关 (bool 特化常量)
+    ShaderVariants& toggle(const std::string& name, uint32_t constantId, bool defaultValue = false);
+    // 声明一个无符号整数常量, 取值范围为 [0, 2^bits)
+    ShaderVariants& constant(const std::string& name, uint32_t constantId, uint32_t bits, uint32_t defaultValue = 0);
+
+    bool has(const std::string& name) const;
+    // 所有常量都取默认值的键
+    uint64_t defaultKey() const;
+    // 返回把 name 设置为 value 后的键, 名字未声明或值超出范围时抛出异常
+    uint64_t set(uint64_t key, const std::string& name, uint32_t value) const;
+    uint32_t get(uint64_t key, const std::string& name) const;
+
+    // 按键填充特化信息 (specialization.info() 指向它自己的成员, 所以它必须在创建管线之后才能销毁)
+    void specialize(uint64_t key, ShaderSpecialization& specialization) const;
+
+private:
+    struct Constant {
+        std::string name;
+        uint32_t constantId;
+        bool isBool;
+        uint32_t bits;
+        uint32_t shift;  // 在键中的起始位
+        uint32_t defaultValue;
+    };
+
+    ShaderVariants& declare(const std::string& name, uint32_t constantId, bool isBool, uint32_t bits, uint32_t defaultValue);
+    const Constant& find(const std::string& name) const;
+
+    std::vector<Constant> constants;
+    uint32_t usedBits = 0;
+};
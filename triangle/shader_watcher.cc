@@ -0,0 +1,157 @@
+#include "shader_watcher.h"
+
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "config.h"
+
+// 编辑器保存一个文件时通常会产生多个事件 (写入、改名等), 收到事件后再等这么久, 把它们合并成一次编译
+static const int DEBOUNCE_MS = 50;
+// 等待事件的超时, 决定析构时停止监视线程的延迟
+static const int POLL_TIMEOUT_MS = 100;
+
+ShaderWatcher::ShaderWatcher(const std::string& sourceDir, const std::vector<std::string>& names, const std::string& outputDir,
+                             const std::string& archivePath)
+    : sourceDir(sourceDir), names(names), outputDir(outputDir), archivePath(archivePath)
+{
+    if (std::string(GLSLC_PATH).empty() || std::string(GLSLC_PATH).find("NOTFOUND") != std::string::npos) {
+        throw std::runtime_error("shader hot reload requires glslc, which was not found at configure time");
+    }
+
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        throw std::runtime_error("failed to initialize inotify!");
+    }
+    // 监视目录而不是文件本身: 很多编辑器保存时写入临时文件再改名覆盖, 原文件的监视会失效
+    if (inotify_add_watch(inotifyFd, sourceDir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(inotifyFd);
+        throw std::runtime_error("failed to watch shader directory " + sourceDir);
+    }
+
+    watcher = std::thread(&ShaderWatcher::watchLoop, this);
+}
+
+ShaderWatcher::~ShaderWatcher() {
+    stopping = true;
+    watcher.join();
+    close(inotifyFd);
+}
+
+std::vector<ShaderReload> ShaderWatcher::poll() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<ShaderReload> result;
+    result.swap(completed);
+    return result;
+}
+
+void ShaderWatcher::watchLoop() {
+    alignas(inotify_event) char buffer[4096];
+    while (!stopping) {
+        pollfd fd{inotifyFd, POLLIN, 0};
+        if (::poll(&fd, 1, POLL_TIMEOUT_MS) <= 0) {
+            continue;
+        }
+
+        // 收集这一批事件中被修改的着色器 (同一个文件只编译一次)
+        auto changedAt = std::chrono::steady_clock::now();
+        std::vector<std::string> changed;
+        do {
+            ssize_t length;
+            while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+                for (char* p = buffer; p < buffer + length; ) {
+                    const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+                    if (event->len > 0) {
+                        std::string name = event->name;
+                        if (std::find(names.begin(), names.end(), name) != names.end() &&
+                            std::find(changed.begin(), changed.end(), name) == changed.end()) {
+                            changed.push_back(name);
+                        }
+                    }
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+        } while (::poll(&fd, 1, DEBOUNCE_MS) > 0 && !stopping);
+
+        bool compiled = false;
+        for (const std::string& name : changed) {
+            ShaderReload reload = compile(name, changedAt);
+            compiled = compiled || reload.ok;
+            std::lock_guard<std::mutex> lock(mutex);
+            completed.push_back(std::move(reload));
+        }
+        if (compiled && !archivePath.empty()) {
+            repackArchive();
+        }
+    }
+}
+
+// 用 outputDir 中的 .spv 重新打包归档。归档通过改名替换, 正在使用旧归档的映射不受影响
+void ShaderWatcher::repackArchive() {
+    std::vector<std::pair<std::string, std::vector<char>>> inputs;
+    for (const std::string& name : names) {
+        std::ifstream file(outputDir + name + ".spv", std::ios::ate | std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "shader reload: " << outputDir << name << ".spv is missing, not repacking " << archivePath << std::endl;
+            return;
+        }
+        std::vector<char> spirv((size_t) file.tellg());
+        file.seekg(0);
+        file.read(spirv.data(), spirv.size());
+        inputs.emplace_back(name, std::move(spirv));
+    }
+    try {
+        writeShaderArchive(archivePath, std::move(inputs));
+    } catch (const std::exception& e) {
+        std::cerr << "shader reload: " << e.what() << std::endl;
+    }
+}
+
+ShaderReload ShaderWatcher::compile(const std::string& name, std::chrono::steady_clock::time_point changedAt) {
+    ShaderReload reload;
+    reload.name = name;
+    reload.changedAt = changedAt;
+
+    // 先输出到临时文件, 编译成功后再改名覆盖, 编译失败时不破坏已有的 .spv
+    std::string output = outputDir + name + ".spv";
+    std::string tmpOutput = output + ".tmp";
+    std::string command = std::string("\"") + GLSLC_PATH + "\" -o \"" + tmpOutput + "\" \"" + sourceDir + name + "\" 2>&1";
+
+    auto start = std::chrono::steady_clock::now();
+    FILE* pipe = popen(command.c_str(), "r");
+    if (!pipe) {
+        reload.log = "failed to run glslc";
+        return reload;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), pipe)) {
+        reload.log += line;
+    }
+    int status = pclose(pipe);
+    reload.compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (status != 0) {
+        std::remove(tmpOutput.c_str());
+        return reload;
+    }
+
+    std::ifstream file(tmpOutput, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        reload.log += "failed to open " + tmpOutput;
+        return reload;
+    }
+    std::vector<char> spirv((size_t) file.tellg());
+    file.seekg(0);
+    file.read(spirv.data(), spirv.size());
+    file.close();
+    std::rename(tmpOutput.c_str(), output.c_str());
+
+    reload.spirv = ShaderCode::fromBytes(std::move(spirv));
+    reload.ok = true;
+    return reload;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shader_archive.h"
+
+// 一次着色器重新编译的结果
+struct ShaderReload {
+    std::string name;                              // 着色器源文件名, 例如 "shader.frag"
+    bool ok = false;
+    ShaderCode spirv;                              // 编译成功时的 SPIR-V 字节码
+    std::string log;                               // glslc 的输出 (编译失败时是错误信息)
+    std::chrono::steady_clock::time_point changedAt; // 检测到文件修改的时间
+    double compileMs = 0.0;
+};
+
+// 着色器热重载: 后台线程用 inotify 监视源码目录, 被监视的着色器源文件保存后调用 glslc 重新编译,
+//   编译得到的 SPIR-V 同时写回 outputDir (和构建时 add_shader 的输出相同), 并重新打包 archivePath 指定的着色器归档,
+//   下次启动直接使用。
+//   渲染线程在帧之间调用 poll 取走编译结果, 自己决定何时用新的字节码重建管线。
+class ShaderWatcher {
+public:
+    // sourceDir: 着色器源码目录; names: 要监视的源文件名; outputDir: .spv 的输出目录;
+    // archivePath: 编译成功后用 outputDir 中所有被监视着色器的 .spv 重新打包的归档 (为空时不打包)
+    ShaderWatcher(const std::string& sourceDir, const std::vector<std::string>& names, const std::string& outputDir,
+                  const std::string& archivePath = "");
+    ~ShaderWatcher();
+
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    // 取走上次调用以来完成的所有编译结果 (不阻塞)
+    std::vector<ShaderReload> poll();
+
+private:
+    void watchLoop();
+    ShaderReload compile(const std::string& name, std::chrono::steady_clock::time_point changedAt);
+    void repackArchive();
+
+    std::string sourceDir;
+    std::vector<std::string> names;
+    std::string outputDir;
+    std::string archivePath;
+
+    int inotifyFd = -1;
+    std::atomic<bool> stopping{false};
+    std::thread watcher;
+
+    std::mutex mutex;
+    std::vector<ShaderReload> completed;
+};
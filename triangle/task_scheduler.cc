@@ -0,0 +1,315 @@
+#include "task_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+
+#include "cpu_trace.h"
+
+// 当前线程所属的调度器和槽位 (外部线程为 nullptr)
+static thread_local const TaskScheduler* tlsScheduler = nullptr;
+static thread_local uint32_t tlsSlot = 0;
+// 当前线程正在执行的任务, 在任务内部提交的任务以它为父任务
+static thread_local void* tlsCurrentTask = nullptr;
+
+// 工作线程找不到任务时, 先自旋这么多次再睡眠, 避免任务密集时频繁地睡眠/唤醒
+static const int IDLE_SPIN_COUNT = 64;
+
+TaskScheduler::TaskScheduler(uint32_t workerCount) {
+    for (uint32_t i = 0; i < workerCount + 1; i++) {
+        queues.emplace_back(new WorkQueue());
+    }
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(&TaskScheduler::workerLoop, this, i);
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (auto& queue : queues) {
+        for (Task* task : queue->tasks) {
+            delete task;
+        }
+    }
+}
+
+uint32_t TaskScheduler::threadSlot() const {
+    return tlsScheduler == this ? tlsSlot : workerCount();
+}
+
+void TaskScheduler::submit(TaskFunction function, TaskCounter* counter) {
+    Task* task = new Task();
+    task->function = std::move(function);
+    task->counter = counter;
+    task->parent = static_cast<Task*>(tlsCurrentTask);
+
+    if (counter) {
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (task->parent) {
+        task->parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    push(threadSlot(), task);
+}
+
+void TaskScheduler::push(uint32_t slot, Task* task) {
+    {
+        std::lock_guard<std::mutex> lock(queues[slot]->mutex);
+        queues[slot]->tasks.push_back(task);
+    }
+
+    // queuedTasks 先加一再检查 sleepingWorkers, 工作线程先增加 sleepingWorkers 再检查 queuedTasks,
+    // 两边都是顺序一致的原子操作, 所以至少有一方能看到对方的修改, 不会丢失唤醒
+    queuedTasks.fetch_add(1);
+    if (sleepingWorkers.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        workAvailable.notify_one();
+    }
+}
+
+// 任务或它的某个祖先任务以 owner 提交。队列中的任务还没完成, 它的祖先任务都还活着, 可以安全地沿 parent 向上查找
+bool TaskScheduler::belongsTo(const Task* task, const TaskCounter* owner) {
+    for (const Task* t = task; t; t = t->parent) {
+        if (t->counter == owner) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TaskScheduler::Task* TaskScheduler::findTask(uint32_t slot, const TaskCounter* owner) {
+    // 先从自己队列的尾部取
+    {
+        WorkQueue& queue = *queues[slot];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (auto it = queue.tasks.rbegin(); it != queue.tasks.rend(); ++it) {
+            if (!owner || belongsTo(*it, owner)) {
+                Task* task = *it;
+                queue.tasks.erase(std::next(it).base());
+                queuedTasks.fetch_sub(1);
+                return task;
+            }
+        }
+    }
+
+    // 再从其它队列的头部窃取, 从相邻的槽位开始, 避免所有线程都去窃取同一个队列
+    for (size_t i = 1; i < queues.size(); i++) {
+        WorkQueue& queue = *queues[(slot + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (auto it = queue.tasks.begin(); it != queue.tasks.end(); ++it) {
+            if (!owner || belongsTo(*it, owner)) {
+                Task* task = *it;
+                queue.tasks.erase(it);
+                queuedTasks.fetch_sub(1);
+                return task;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void TaskScheduler::execute(Task* task) {
+    TRACE_SCOPE("task");
+    void* previousTask = tlsCurrentTask;
+    tlsCurrentTask = task;
+    try {
+        task->function();
+    } catch (...) {
+        recordError(task, std::current_exception());
+    }
+    tlsCurrentTask = previousTask;
+
+    finish(task);
+}
+
+// 异常记录在任务自己的计数器上; 没有计数器的子任务记录在最近的带计数器的祖先任务上 (它的 wait 要等这个子任务完成)。
+//   一直没有计数器说明没有人会等待这个任务, 和线程中未捕获的异常一样终止程序
+void TaskScheduler::recordError(Task* task, std::exception_ptr error) {
+    for (Task* t = task; t; t = t->parent) {
+        if (t->counter) {
+            std::lock_guard<std::mutex> lock(t->counter->errorMutex);
+            if (!t->counter->error) {
+                t->counter->error = error;
+            }
+            return;
+        }
+    }
+    std::terminate();
+}
+
+// 任务本身或它的一个子任务完成。全部完成时通知计数器, 并向上通知父任务
+void TaskScheduler::finish(Task* task) {
+    if (task->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    if (task->counter) {
+        task->counter->pending.fetch_sub(1, std::memory_order_release);
+    }
+    Task* parent = task->parent;
+    delete task;
+    if (parent) {
+        finish(parent);
+    }
+}
+
+void TaskScheduler::workerLoop(uint32_t slot) {
+    tlsScheduler = this;
+    tlsSlot = slot;
+    TRACE_THREAD_NAME("worker " + std::to_string(slot));
+
+    int idleSpins = 0;
+    while (!stopping) {
+        Task* task = findTask(slot);
+        if (task) {
+            execute(task);
+            idleSpins = 0;
+            continue;
+        }
+
+        if (++idleSpins < IDLE_SPIN_COUNT) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingWorkers.fetch_add(1);
+        workAvailable.wait(lock, [this] { return stopping || queuedTasks.load() > 0; });
+        sleepingWorkers.fetch_sub(1);
+        idleSpins = 0;
+    }
+}
+
+void TaskScheduler::wait(TaskCounter& counter) {
+    uint32_t slot = threadSlot();
+    while (!counter.done()) {
+        Task* task = findTask(slot, &counter);
+        if (task) {
+            execute(task);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(counter.errorMutex);
+        std::swap(error, counter.error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+uint32_t TaskScheduler::runPending(uint32_t maxTasks) {
+    if (!workers.empty()) {
+        return 0;
+    }
+    uint32_t slot = threadSlot();
+    uint32_t executed = 0;
+    while (executed < maxTasks) {
+        Task* task = findTask(slot);
+        if (!task) {
+            break;
+        }
+        execute(task);
+        executed++;
+    }
+    return executed;
+}
+
+void TaskScheduler::parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t begin, uint32_t end)>& fn) {
+    grain = std::max(grain, 1u);
+    TaskCounter counter;
+    for (uint32_t begin = 0; begin < count; begin += grain) {
+        uint32_t end = std::min(count, begin + grain);
+        submit([&fn, begin, end] { fn(begin, end); }, &counter);
+    }
+    wait(counter);
+}
+
+// 计算密集的测试负载 (大约几微秒)
+static double busyWork(uint32_t seed, uint32_t iterations) {
+    double x = seed;
+    for (uint32_t i = 0; i < iterations; i++) {
+        x = std::sqrt(x * x + 1.0);
+    }
+    return x;
+}
+
+// 递归地把区间一分为二提交子任务, 测试父子任务和工作窃取
+static void spawnTree(TaskScheduler& scheduler, uint32_t count, std::atomic<uint64_t>& leaves) {
+    if (count <= 1) {
+        leaves.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    uint32_t half = count / 2;
+    scheduler.submit([&scheduler, half, &leaves] { spawnTree(scheduler, half, leaves); });
+    scheduler.submit([&scheduler, count, half, &leaves] { spawnTree(scheduler, count - half, leaves); });
+}
+
+void runTaskSchedulerBenchmark(uint32_t taskCount, std::ostream& out) {
+    const uint32_t WORK_ITERATIONS = 500;
+    uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t t = 1; t < hardwareThreads; t *= 2) {
+        threadCounts.push_back(t);
+    }
+    threadCounts.push_back(hardwareThreads);
+
+    out << "task scheduler benchmark: " << taskCount << " tasks, " << hardwareThreads << " hardware threads" << std::endl;
+
+    double serialWorkMs = 0.0;
+    for (uint32_t threads : threadCounts) {
+        // 外部线程在 wait 中也执行任务, 所以 threads 个线程需要 threads - 1 个工作线程
+        TaskScheduler scheduler(threads - 1);
+
+        // 空任务: 每个任务的提交、调度和完成开销
+        auto start = std::chrono::steady_clock::now();
+        {
+            TaskCounter counter;
+            for (uint32_t i = 0; i < taskCount; i++) {
+                scheduler.submit([] {}, &counter);
+            }
+            scheduler.wait(counter);
+        }
+        double emptyNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / taskCount;
+
+        // 父子任务: 从一个根任务递归展开, 任务分布在各个线程的队列上, 靠窃取分配
+        std::atomic<uint64_t> leaves{0};
+        start = std::chrono::steady_clock::now();
+        {
+            TaskCounter counter;
+            scheduler.submit([&scheduler, taskCount, &leaves] { spawnTree(scheduler, taskCount, leaves); }, &counter);
+            scheduler.wait(counter);
+        }
+        double treeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / taskCount;
+
+        // 计算密集任务: 加速比
+        std::vector<double> results(taskCount);
+        start = std::chrono::steady_clock::now();
+        scheduler.parallelFor(taskCount, 16, [&results](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                results[i] = busyWork(i, WORK_ITERATIONS);
+            }
+        });
+        double workMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (threads == 1) {
+            serialWorkMs = workMs;
+        }
+
+        out << "  " << threads << " threads: empty task " << emptyNs << " ns, tree task " << treeNs << " ns ("
+            << leaves.load() << " leaves), busy work " << workMs << " ms (" << serialWorkMs / workMs << "x)" << std::endl;
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+// 任务计数器: 提交任务时加一, 任务 (连同它的所有子任务) 完成时减一, 归零表示这一组任务全部完成。
+//   这一组任务抛出的第一个异常记录在计数器上, 只在 wait 这个计数器时重新抛出
+class TaskCounter {
+public:
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class TaskScheduler;
+    std::atomic<uint32_t> pending{0};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+};
+
+// 工作窃取 (work stealing) 任务调度器。
+//   每个线程有自己的任务队列: 线程从自己队列的尾部取任务 (后进先出, 缓存友好), 自己的队列为空时从其它线程队列的头部窃取
+//   (先进先出, 窃取到的通常是较大的任务)。在任务内部提交的任务是当前任务的子任务, 父任务要等所有子任务完成后才算完成。
+//   调用 wait 的线程在等待期间也会执行任务, 但只执行属于被等待计数器的任务 (及其子任务): 无关的长任务 (例如后台的管线编译)
+//   不会拖长等待, 在任务内部等待也不会死锁。
+//
+//   调度器之外的线程 (通常是主线程) 共用最后一个线程槽位, 同一时间只能有一个外部线程调用 wait。
+//   threadSlot() 返回当前线程的槽位, 可以用来索引每个线程独占的资源 (例如每个线程自己的指令池)。
+class TaskScheduler {
+public:
+    using TaskFunction = std::function<void()>;
+
+    explicit TaskScheduler(uint32_t workerCount);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // 提交任务, counter 不为空时在任务及其子任务全部完成后减一
+    void submit(TaskFunction function, TaskCounter* counter = nullptr);
+    // 等待 counter 归零, 等待期间当前线程也执行任务。counter 的任务 (及其子任务) 抛出的异常在这里重新抛出
+    void wait(TaskCounter& counter);
+    // 没有工作线程时, 不属于任何等待中的计数器的任务 (例如后台的管线编译) 只能由外部线程执行:
+    //   在调用线程上执行最多 maxTasks 个排队的任务, 返回执行的任务数。有工作线程时由它们执行, 直接返回 0, 不占用调用线程
+    uint32_t runPending(uint32_t maxTasks = 1);
+    // 把 [0, count) 拆分成大小为 grain 的区间并行执行 fn(begin, end), 阻塞直到全部完成
+    void parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t begin, uint32_t end)>& fn);
+
+    uint32_t workerCount() const { return static_cast<uint32_t>(workers.size()); }
+    // 线程槽位数: 工作线程数 + 1 (外部线程)
+    uint32_t threadSlotCount() const { return workerCount() + 1; }
+    uint32_t threadSlot() const;
+
+private:
+    struct Task {
+        TaskFunction function;
+        Task* parent;
+        TaskCounter* counter;
+        std::atomic<uint32_t> unfinished{1};  // 任务本身 + 未完成的子任务数
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task*> tasks;
+    };
+
+    void workerLoop(uint32_t slot);
+    void push(uint32_t slot, Task* task);
+    // owner 不为空时只取属于 owner 的任务
+    Task* findTask(uint32_t slot, const TaskCounter* owner = nullptr);
+    void execute(Task* task);
+    void finish(Task* task);
+    static void recordError(Task* task, std::exception_ptr error);
+    static bool belongsTo(const Task* task, const TaskCounter* owner);
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;  // 每个线程槽位一个
+    std::vector<std::thread> workers;
+
+    std::atomic<uint32_t> queuedTasks{0};
+    std::atomic<uint32_t> sleepingWorkers{0};
+    std::mutex sleepMutex;
+    std::condition_variable workAvailable;
+    std::atomic<bool> stopping{false};
+};
+
+// 调度器微基准测试: 测量每个任务的调度开销, 以及计算密集任务随线程数增加的加速比
+void runTaskSchedulerBenchmark(uint32_t taskCount, std::ostream& out);
@@ -1,21 +1,340 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
 #include <cstring>
+#include <cstdio>
 #include <vector>
 #include <optional>
 #include <map>
 #include <set>
 #include <algorithm>
 #include <fstream>
+#include <limits>
+#include <array>
+#include <deque>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <filesystem>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
 #include "config.h"
+#include "frame_encoder.h"
+#include "gpu_allocator.h"
+#include "frame_arena.h"
+#include "task_scheduler.h"
+#include "pipeline_builder.h"
+#include "shader_archive.h"
+#include "shader_watcher.h"
+#include "shader_variant.h"
+#include "gpu_profiler.h"
+#include "cpu_trace.h"
+#include "frame_pacer.h"
+#include "queue_timeline.h"
+#include "queue_ownership.h"
+#include "compute_pass.h"
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
+// 可以同时处理的帧数 (frames in flight) 的上限, 默认值由延迟策略决定 (见 LatencyPolicy)
+const uint32_t MAX_FRAMES_IN_FLIGHT_LIMIT = 8;
+// 没有 --latency-policy 时从这个环境变量读取延迟策略
+const char* const LATENCY_POLICY_ENV = "TRI_LATENCY_POLICY";
+
+// 管线缓存文件, 保存编译好的管线数据, 下次启动时可以跳过大部分管线编译工作
+const std::string PIPELINE_CACHE_FILE = TEST_BIN_PATH "pipeline_cache.bin";
+// 构建时生成的着色器归档 (add_all_shader, 以目标名命名)
+const std::string SHADER_ARCHIVE_FILE = TEST_BIN_PATH "tri.spvpack";
+// 材质色调在片段着色器变体键中占用的位数 (TINT 特化常量), 色调编号 0 表示不着色
+const uint32_t MATERIAL_TINT_BITS = 16;
+const uint32_t MAX_MATERIAL_TINTS = (1u << MATERIAL_TINT_BITS) - 1;
+
+// 无窗口模式下离屏图像的格式 (RGBA8, 便于直接回读保存)
+const VkFormat OFFSCREEN_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+// 无窗口模式下默认绘制的帧数
+const uint32_t DEFAULT_HEADLESS_FRAMES = 1000;
+// 回读暂存缓冲环中, 除了 in-flight 帧正在写入的缓冲以外, 额外留给编码线程的缓冲数量 (每个编码线程)
+const uint32_t READBACK_BUFFERS_PER_ENCODER = 2;
+// 每个 in-flight 帧的 uniform 线性分配区域的默认大小 (KB)
+const uint32_t DEFAULT_FRAME_ARENA_KB = 64;
+
+// 命令行参数
+struct AppOptions {
+    uint32_t width = WIDTH;        // 窗口 (或无窗口模式下离屏图像) 的初始尺寸
+    uint32_t height = HEIGHT;
+    uint32_t maxFramesInFlight = 0; // 同时处理的最大帧数, 0 表示由延迟策略决定 (解析完参数后填入)
+    LatencyPolicy latencyPolicy = LatencyPolicy::Balanced; // 延迟策略, 决定默认的交换链图像数和 in-flight 帧数
+    std::string latencyPolicySource = "default"; // 延迟策略的来源 (启动时输出)
+    uint32_t benchmarkFrames = 0;  // 大于 0 时进入帧时间测试模式, 每种配置测量的帧数
+    bool staticScene = false;      // 静态场景模式: 为每个交换链图像预先录制指令缓冲, 之后重复提交
+    bool pipelineCacheReport = false; // 启动时分别测量无缓存 (cold) 和有缓存 (warm) 时的管线创建耗时
+    bool headless = false;         // 无窗口模式: 不创建 GLFW 窗口和交换链, 绘制到应用自己创建的离屏图像
+    uint32_t maxFrames = 0;        // 绘制的帧数上限, 0 表示不限制 (无窗口模式下默认为 DEFAULT_HEADLESS_FRAMES)
+    uint32_t resizeStorm = 0;      // 大于 0 时进行窗口尺寸压力测试: 连续改变窗口尺寸 N 次, 统计交换链重建的停顿时间
+    uint32_t triangles = 0;        // 大于 0 时绘制由 N 个三角形组成的网格 (用于几何吞吐量测试), 0 表示只绘制一个三角形
+    uint32_t frameArenaKb = DEFAULT_FRAME_ARENA_KB; // 每帧 uniform 线性分配区域的大小
+    uint32_t draws = 1;            // 把几何数据拆分成多少次绘制调用
+    uint32_t recordThreads = 0;    // 把录制拆分成多少个并行任务, 0 表示在主线程直接录制 (不使用辅助指令缓冲)
+    uint32_t recordBenchmark = 0;  // 大于 0 时进行录制测试: 以不同的并行任务数各绘制 N 帧, 对比录制耗时
+    uint32_t workerThreads = std::max(1u, std::thread::hardware_concurrency()) - 1; // 任务调度器的工作线程数 (主线程在等待任务时也会执行任务)
+    uint32_t materials = 1;        // 材质数, 绘制列表按顺序均分给各个材质
+    uint32_t materialTints = 0;    // 不同色调 (即不同管线状态) 的数量, 材质依次循环使用; 0 表示每种材质一个色调
+    std::vector<std::pair<std::string, uint32_t>> shaderVariants; // 覆盖着色器变体常量的默认值 (名字, 值)
+    bool gpuProfile = false;       // 用时间戳查询测量每个渲染流程的 GPU 耗时, 每秒输出一次滚动平均
+    bool gpuCull = false;          // 每帧用计算着色器做视锥剔除, 绘制改为间接绘制 (有专用计算队列时异步执行)
+    std::string cpuTraceFile;      // 非空时记录 CPU 帧时间线 (TRACE_SCOPE), 退出时写出 Chrome trace JSON
+    std::optional<VkPresentModeKHR> presentMode; // 指定的呈现模式, 没有指定时优先使用 MAILBOX, 否则使用 FIFO
+    uint32_t swapChainImages = 0;  // 交换链图像数, 0 表示由延迟策略决定
+    uint32_t targetFps = 0;        // 大于 0 时在 CPU 上把帧率限制为该值
+    std::string pacingCsv;         // 非空时把帧节奏统计 (帧时间百分位数、抖动、延迟) 追加到该 CSV 文件
+    uint32_t pacingCompare = 0;    // 大于 0 时依次使用每种支持的呈现模式各绘制 N 帧, 对比帧节奏
+    bool pipelineBuildReport = false; // 启动时对比在主线程串行编译和用编译服务并行编译整套材质管线的耗时
+    bool watchShaders = false;     // 监视着色器源码, 修改后在运行时重新编译并替换管线
+    uint32_t shaderLoadBenchmark = 0; // 大于 0 时进行着色器加载测试: 对比逐个读取 N 个 .spv 文件和映射归档的冷/热加载耗时
+    uint32_t schedulerBenchmark = 0; // 大于 0 时只运行任务调度器的微基准测试 (N 个任务), 不初始化 Vulkan
+    std::vector<VkExtent2D> extraTargets; // 无窗口模式下额外以这些分辨率绘制同一场景 (和主图像共用同一个管线)
+    std::string dumpDir;           // 非空时回读每一帧并保存到该目录 (仅无窗口模式)
+    FrameFormat dumpFormat = FrameFormat::Png; // 帧保存格式
+    uint32_t dumpThreads = 1;      // 编码线程数
+};
+
+void printUsage(const char* program) {
+    std::cout << "usage: " << program << " [options]\n"
+              << "  --size WxH             窗口 (或离屏图像) 尺寸, 默认 " << WIDTH << "x" << HEIGHT << "\n"
+              << "  --frames-in-flight N   同时处理的最大帧数 (1-" << MAX_FRAMES_IN_FLIGHT_LIMIT << ", 默认由延迟策略决定)\n"
+              << "  --latency-policy P     延迟策略: low_latency, balanced (默认), max_throughput, 决定交换链图像数和 in-flight 帧数;\n"
+              << "                         也可以通过环境变量 " << LATENCY_POLICY_ENV << " 指定\n"
+              << "  --benchmark N          帧时间测试模式: 分别以 1 帧和 N 帧并行各绘制 N 帧, 输出吞吐量对比\n"
+              << "  --static-scene         静态场景模式: 指令缓冲只录制一次, 场景被标记为脏 (按 R 键) 时才重新录制\n"
+              << "  --pipeline-cache-report 对比无管线缓存和有管线缓存时的管线创建耗时\n"
+              << "  --headless             无窗口模式: 绘制到离屏图像, 不受显示刷新率限制\n"
+              << "  --extra-target WxH     无窗口模式下每帧额外以 WxH 分辨率绘制同一场景, 可以指定多次\n"
+              << "  --frames N             绘制 N 帧后退出 (无窗口模式默认 " << DEFAULT_HEADLESS_FRAMES << ")\n"
+              << "  --triangles N          绘制由 N 个三角形组成的网格, 输出上传带宽和三角形吞吐量\n"
+              << "  --draws N              把几何数据拆分成 N 次绘制调用 (默认 1)\n"
+              << "  --record-threads N     把录制拆分成 N 个并行任务, 录制到辅助指令缓冲 (默认 0, 在主线程录制)\n"
+              << "  --record-benchmark N   录制测试: 以不同的并行任务数各绘制 N 帧, 输出每帧录制耗时\n"
+              << "  --worker-threads N     任务调度器的工作线程数 (默认为 CPU 线程数 - 1)\n"
+              << "  --materials N          使用 N 种材质 (启动时并行编译各自的管线, 默认 1)\n"
+              << "  --material-tints N     材质只使用 N 种色调, 状态相同的材质共用管线 (默认每种材质一种色调)\n"
+              << "  --variant NAME=VALUE   设置着色器的特化常量, 例如 GRAYSCALE=1, 可以指定多次\n"
+              << "  --pipeline-build-report 对比串行编译和并行编译全部材质管线的耗时\n"
+              << "  --gpu-profile          测量每个渲染流程的 GPU 耗时 (时间戳查询), 每秒输出最近若干帧的平均值\n"
+              << "  --gpu-cull             在 GPU 上做视锥剔除 (cull.comp), 用间接绘制提交剔除后的绘制列表\n"
+              << "  --present-mode MODE    呈现模式: immediate, mailbox, fifo, fifo_relaxed (默认 mailbox, 不支持时 fifo)\n"
+              << "  --swapchain-images N   交换链图像数 (默认由延迟策略决定)\n"
+              << "  --target-fps N         在 CPU 上把帧率限制为 N\n"
+              << "  --pacing-csv FILE      把帧时间百分位数、抖动和输入到呈现的延迟追加到 CSV 文件\n"
+              << "  --pacing-compare N     依次使用每种支持的呈现模式各绘制 N 帧, 对比帧节奏 (可以和 --pacing-csv 一起使用)\n"
+              << "  --cpu-trace FILE       记录 CPU 帧时间线, 退出时写出 Chrome trace JSON (和 --gpu-profile 一起使用时包含 GPU 范围)\n"
+              << "  --watch-shaders        着色器源码修改后自动重新编译 (glslc) 并替换管线, 不需要重启\n"
+              << "  --shader-load-benchmark N 着色器加载测试: 逐个读取 N 个 .spv 文件和映射一个归档, 对比冷/热加载耗时\n"
+              << "  --scheduler-benchmark N 任务调度器微基准测试: 每种线程数执行 N 个任务, 输出每个任务的开销和加速比\n"
+              << "  --frame-arena-kb N     每帧 uniform 数据区域的大小 (KB, 默认 " << DEFAULT_FRAME_ARENA_KB << "), 退出时输出峰值用量\n"
+              << "  --resize-storm N       窗口尺寸压力测试: 每帧改变一次窗口尺寸, 共 N 次, 输出交换链重建的停顿时间\n"
+              << "  --dump-dir DIR         回读绘制结果并保存到 DIR (需要 --headless), 编码线程跟不上时丢弃多余的帧\n"
+              << "  --dump-format FMT      帧保存格式: png (默认), jpg, raw\n"
+              << "  --dump-threads N       编码线程数 (默认 1)\n"
+              << "  --help                 打印帮助\n";
+}
+
+// 解析命令行参数, 参数不合法时抛出异常
+AppOptions parseOptions(int argc, char* argv[]) {
+    AppOptions options;
+
+    auto nextValue = [&](int& i) -> std::string {
+        if (i + 1 >= argc) {
+            throw std::runtime_error(std::string("missing value for option ") + argv[i]);
+        }
+        return argv[++i];
+    };
+    auto toUint = [](const std::string& opt, const std::string& value) -> uint32_t {
+        try {
+            size_t pos = 0;
+            unsigned long v = std::stoul(value, &pos);
+            if (pos != value.size() || v > std::numeric_limits<uint32_t>::max()) {
+                throw std::invalid_argument(value);
+            }
+            return static_cast<uint32_t>(v);
+        } catch (const std::logic_error&) {
+            throw std::runtime_error("invalid value for " + opt + ": " + value);
+        }
+    };
+    // 数量类参数不接受 0
+    auto toPositiveUint = [&toUint](const std::string& opt, const std::string& value) -> uint32_t {
+        uint32_t v = toUint(opt, value);
+        if (v == 0) {
+            throw std::runtime_error("invalid value for " + opt + ": " + value + " (must be at least 1)");
+        }
+        return v;
+    };
+
+    auto toExtent = [](const std::string& opt, const std::string& value) -> VkExtent2D {
+        unsigned int w = 0, h = 0;
+        char tail = 0;
+        if (sscanf(value.c_str(), "%ux%u%c", &w, &h, &tail) != 2 || w == 0 || h == 0) {
+            throw std::runtime_error("invalid value for " + opt + ": " + value + " (expected WxH)");
+        }
+        return {w, h};
+    };
+
+    if (const char* policy = std::getenv(LATENCY_POLICY_ENV)) {
+        if (!parseLatencyPolicy(policy, options.latencyPolicy)) {
+            throw std::runtime_error(std::string("unsupported latency policy in ") + LATENCY_POLICY_ENV + ": " + policy);
+        }
+        options.latencyPolicySource = LATENCY_POLICY_ENV;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--size") {
+            VkExtent2D extent = toExtent(arg, nextValue(i));
+            options.width = extent.width;
+            options.height = extent.height;
+        } else if (arg == "--extra-target") {
+            options.extraTargets.push_back(toExtent(arg, nextValue(i)));
+        } else if (arg == "--frames-in-flight") {
+            options.maxFramesInFlight = toUint(arg, nextValue(i));
+            if (options.maxFramesInFlight == 0 || options.maxFramesInFlight > MAX_FRAMES_IN_FLIGHT_LIMIT) {
+                throw std::runtime_error("--frames-in-flight must be in [1, " + std::to_string(MAX_FRAMES_IN_FLIGHT_LIMIT) + "]");
+            }
+        } else if (arg == "--latency-policy") {
+            std::string value = nextValue(i);
+            if (!parseLatencyPolicy(value, options.latencyPolicy)) {
+                throw std::runtime_error("unsupported latency policy: " + value);
+            }
+            options.latencyPolicySource = "--latency-policy";
+        } else if (arg == "--benchmark") {
+            options.benchmarkFrames = toUint(arg, nextValue(i));
+        } else if (arg == "--static-scene") {
+            options.staticScene = true;
+        } else if (arg == "--pipeline-cache-report") {
+            options.pipelineCacheReport = true;
+        } else if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--frames") {
+            options.maxFrames = toUint(arg, nextValue(i));
+        } else if (arg == "--triangles") {
+            options.triangles = toUint(arg, nextValue(i));
+        } else if (arg == "--draws") {
+            options.draws = toPositiveUint(arg, nextValue(i));
+        } else if (arg == "--record-threads") {
+            options.recordThreads = toUint(arg, nextValue(i));
+        } else if (arg == "--record-benchmark") {
+            options.recordBenchmark = toUint(arg, nextValue(i));
+        } else if (arg == "--worker-threads") {
+            options.workerThreads = toUint(arg, nextValue(i));
+        } else if (arg == "--materials") {
+            options.materials = toPositiveUint(arg, nextValue(i));
+        } else if (arg == "--material-tints") {
+            options.materialTints = toUint(arg, nextValue(i));
+        } else if (arg == "--variant") {
+            std::string value = nextValue(i);
+            size_t equals = value.find('=');
+            if (equals == std::string::npos || equals == 0) {
+                throw std::runtime_error("--variant expects NAME=VALUE, got " + value);
+            }
+            options.shaderVariants.emplace_back(value.substr(0, equals), toUint(arg, value.substr(equals + 1)));
+        } else if (arg == "--gpu-profile") {
+            options.gpuProfile = true;
+        } else if (arg == "--gpu-cull") {
+            options.gpuCull = true;
+        } else if (arg == "--present-mode") {
+            std::string value = nextValue(i);
+            VkPresentModeKHR mode;
+            if (!parsePresentMode(value, mode)) {
+                throw std::runtime_error("unsupported present mode: " + value);
+            }
+            options.presentMode = mode;
+        } else if (arg == "--swapchain-images") {
+            options.swapChainImages = toUint(arg, nextValue(i));
+        } else if (arg == "--target-fps") {
+            options.targetFps = toUint(arg, nextValue(i));
+        } else if (arg == "--pacing-csv") {
+            options.pacingCsv = nextValue(i);
+        } else if (arg == "--pacing-compare") {
+            options.pacingCompare = toUint(arg, nextValue(i));
+        } else if (arg == "--cpu-trace") {
+            options.cpuTraceFile = nextValue(i);
+            if (!ENABLE_CPU_TRACE) {
+                throw std::runtime_error("--cpu-trace requires a build with ENABLE_CPU_TRACE");
+            }
+        } else if (arg == "--pipeline-build-report") {
+            options.pipelineBuildReport = true;
+        } else if (arg == "--watch-shaders") {
+            options.watchShaders = true;
+        } else if (arg == "--shader-load-benchmark") {
+            options.shaderLoadBenchmark = toUint(arg, nextValue(i));
+        } else if (arg == "--scheduler-benchmark") {
+            options.schedulerBenchmark = toUint(arg, nextValue(i));
+        } else if (arg == "--frame-arena-kb") {
+            options.frameArenaKb = toPositiveUint(arg, nextValue(i));
+        } else if (arg == "--resize-storm") {
+            options.resizeStorm = toUint(arg, nextValue(i));
+        } else if (arg == "--dump-dir") {
+            options.dumpDir = nextValue(i);
+        } else if (arg == "--dump-format") {
+            std::string value = nextValue(i);
+            if (!parseFrameFormat(value, options.dumpFormat)) {
+                throw std::runtime_error("unsupported dump format: " + value);
+            }
+        } else if (arg == "--dump-threads") {
+            options.dumpThreads = toPositiveUint(arg, nextValue(i));
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            std::exit(EXIT_SUCCESS);
+        } else {
+            printUsage(argv[0]);
+            throw std::runtime_error("unknown option: " + arg);
+        }
+    }
+
+    // 没有明确指定 in-flight 帧数时使用延迟策略的设置 (交换链图像数在创建交换链时按表面的最小图像数计算)
+    if (options.maxFramesInFlight == 0) {
+        options.maxFramesInFlight = latencyPolicySettings(options.latencyPolicy).framesInFlight;
+    }
+    if (options.headless && options.maxFrames == 0) {
+        options.maxFrames = DEFAULT_HEADLESS_FRAMES;
+    }
+    // 交换链图像不能作为拷贝源, 回读只支持离屏图像; 静态场景的指令缓冲按图像预先录制, 无法每帧写入不同的暂存缓冲
+    if (!options.dumpDir.empty() && (!options.headless || options.staticScene)) {
+        throw std::runtime_error("--dump-dir requires --headless and cannot be combined with --static-scene");
+    }
+    if (options.resizeStorm > 0 && options.headless) {
+        throw std::runtime_error("--resize-storm requires a window");
+    }
+    // 辅助指令缓冲从每帧重置的指令池中分配, 不能被静态场景反复提交
+    if ((options.recordThreads > 0 || options.recordBenchmark > 0) && options.staticScene) {
+        throw std::runtime_error("--record-threads and --record-benchmark cannot be combined with --static-scene");
+    }
+    if (!options.extraTargets.empty() && !options.headless) {
+        throw std::runtime_error("--extra-target requires --headless");
+    }
+    if ((options.presentMode || options.swapChainImages > 0 || options.pacingCompare > 0) && options.headless) {
+        throw std::runtime_error("--present-mode, --swapchain-images and --pacing-compare require a window");
+    }
+    // 时间戳查询每次提交前都要重置, 预先录制后反复提交的指令缓冲无法使用
+    if (options.gpuProfile && options.staticScene) {
+        throw std::runtime_error("--gpu-profile cannot be combined with --static-scene");
+    }
+    // 剔除结果每帧重新计算, 写入该帧的间接绘制缓冲, 预先录制的指令缓冲无法跟随
+    if (options.gpuCull && options.staticScene) {
+        throw std::runtime_error("--gpu-cull cannot be combined with --static-scene");
+    }
+
+    return options;
+}
+
 // 我们要启用的校验层列表
 const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
@@ -54,9 +373,89 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
     }
 }
 
+// 顶点数据 (位置和颜色交错存放在同一个缓冲中)
+struct Vertex {
+    glm::vec2 pos;
+    glm::vec3 color;
+
+    // 顶点绑定: 描述顶点数据在缓冲中的间隔, 以及按顶点还是按实例读取
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(Vertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescription;
+    }
+
+    // 顶点属性: 对应顶点着色器中的 location, 描述每个属性在顶点中的格式和偏移
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;  // vec2
+        attributeDescriptions[0].offset = offsetof(Vertex, pos);
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;  // vec3
+        attributeDescriptions[1].offset = offsetof(Vertex, color);
+
+        return attributeDescriptions;
+    }
+};
+
+// 每次绘制使用的 uniform 数据, 每帧从 FrameArena 中分配, 通过动态偏移绑定 (对应 shader.vert 中的 FrameUniforms)
+struct FrameUniforms {
+    glm::mat4 transform;
+};
+
+// 生成场景几何数据: triangles 为 0 时只有一个三角形, 否则是铺满屏幕的网格, 相邻的两个三角形共用一个四边形的顶点
+void generateGeometry(uint32_t triangles, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+    if (triangles == 0) {
+        vertices = {
+            {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
+            {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
+            {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}
+        };
+        indices = {0, 1, 2};
+        return;
+    }
+
+    uint32_t quads = (triangles + 1) / 2;
+    uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(quads))));
+
+    vertices.clear();
+    vertices.reserve(static_cast<size_t>(side + 1) * (side + 1));
+    for (uint32_t y = 0; y <= side; y++) {
+        for (uint32_t x = 0; x <= side; x++) {
+            float u = static_cast<float>(x) / side;
+            float v = static_cast<float>(y) / side;
+            vertices.push_back({{u * 2.0f - 1.0f, v * 2.0f - 1.0f}, {u, v, 1.0f - u}});
+        }
+    }
+
+    indices.clear();
+    indices.reserve(static_cast<size_t>(triangles) * 3);
+    for (uint32_t q = 0; q < quads; q++) {
+        uint32_t x = q % side;
+        uint32_t y = q / side;
+        uint32_t i0 = y * (side + 1) + x;
+        uint32_t i1 = i0 + 1;
+        uint32_t i2 = i0 + side + 1;
+        uint32_t i3 = i2 + 1;
+        indices.insert(indices.end(), {i0, i1, i2});
+        if (indices.size() < static_cast<size_t>(triangles) * 3) {
+            indices.insert(indices.end(), {i1, i3, i2});
+        }
+    }
+}
+
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;  // 绘制指令的队列族
     std::optional<uint32_t> presentFamily;   // 呈现的队列族
+    std::optional<uint32_t> transferFamily;  // 专用传输队列族 (只支持传输, 通常对应独立的 DMA 引擎), 没有时使用图形队列上传数据
+    std::optional<uint32_t> computeFamily;   // 专用计算队列族 (支持计算但不支持图形, 异步计算), 没有时计算在图形队列上执行
 
     bool isComplete() {
         return graphicsFamily.has_value() && presentFamily.has_value();
@@ -71,115 +470,589 @@ struct SwapChainSupportDetails {
 
 class HelloTriangleApplication {
 public:
+    explicit HelloTriangleApplication(const AppOptions& options)
+        : options(options), requestedPresentMode(options.presentMode), framePacer(options.targetFps) {}
+
     void run() {
+        scheduler.reset(new TaskScheduler(options.workerThreads));
         initWindow();
         initVulkan();
-        mainLoop();
+        if (options.benchmarkFrames > 0) {
+            runBenchmark();
+        } else if (options.recordBenchmark > 0) {
+            runRecordBenchmark();
+        } else if (options.shaderLoadBenchmark > 0) {
+            runShaderLoadBenchmark();
+        } else if (options.resizeStorm > 0) {
+            runResizeStorm();
+        } else if (options.pacingCompare > 0) {
+            runPacingComparison();
+        } else {
+            mainLoop();
+        }
+        reportStatistics();
         cleanup();
     }
 
 private:
-    GLFWwindow* window;
+    AppOptions options;
+
+    std::unique_ptr<TaskScheduler> scheduler;  // 启动时的资源加载和每帧的并行录制都以任务的形式在这里执行
+
+    GLFWwindow* window = nullptr;  // 无窗口模式下为 nullptr
 
     VkInstance instance;
     VkDebugUtilsMessengerEXT debugMessenger;  // 该对象来存储回调函数信息
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;  // 无窗口模式下不创建
 
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkDevice device;  // 逻辑设备来作为和物理设备交互的接口
+    std::unique_ptr<GpuAllocator> allocator;  // 所有缓冲和图像的设备内存都从这里子分配
 
     VkQueue graphicsQueue;
     VkQueue presentQueue;
-
-    VkSwapchainKHR swapChain;  // 交换链
+    VkQueue transferQueue;  // 没有专用传输队列族时和 graphicsQueue 相同
+    VkQueue computeQueue;   // 没有专用计算队列族时和 graphicsQueue 相同
+    // 每个队列一个时间线信号量, 帧和上传都用 (信号量, 值) 同步。没有专用队列时 transferTimeline/computeTimeline 指向 graphicsTimeline
+    std::unique_ptr<QueueTimeline> graphicsTimeline;
+    std::unique_ptr<QueueTimeline> ownedTransferTimeline;
+    std::unique_ptr<QueueTimeline> ownedComputeTimeline;
+    QueueTimeline* transferTimeline = nullptr;
+    QueueTimeline* computeTimeline = nullptr;
+
+    // 无窗口模式下没有交换链, 下面的 swapChain* 成员保存的是应用自己创建的离屏图像 (每个 in-flight 帧一张), 这样绘制流程可以共用
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;  // 交换链
     std::vector<VkImage> swapChainImages; // 交换链图像句柄
+    std::vector<GpuAllocation> offscreenImageAllocations; // 离屏图像的内存 (交换链图像的内存由交换链管理)
+
+    // 无窗口模式下的额外渲染目标: 和主图像使用同一个渲染流程和管线, 以不同的分辨率绘制同一场景
+    struct ExtraTarget {
+        VkExtent2D extent;
+        std::vector<VkImage> images;          // 每个 in-flight 帧一张
+        std::vector<GpuAllocation> allocations;
+        std::vector<VkImageView> imageViews;
+        std::vector<VkFramebuffer> framebuffers;
+    };
+    std::vector<ExtraTarget> extraTargets;
     VkFormat swapChainImageFormat; // 表面格式
+    VkPresentModeKHR swapChainPresentMode = VK_PRESENT_MODE_FIFO_KHR; // 交换链实际使用的呈现模式
+    std::optional<VkPresentModeKHR> requestedPresentMode;  // 创建交换链时请求的呈现模式 (呈现模式对比时依次改变)
     VkExtent2D swapChainExtent;    // 交换范围 (分辨率)
     std::vector<VkImageView> swapChainImageViews;  // 图像视图
     std::vector<VkFramebuffer> swapChainFramebuffers;
 
     VkRenderPass renderPass;
+    VkDescriptorSetLayout descriptorSetLayout;  // 一个动态 uniform 缓冲 (FrameUniforms)
     VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
 
-    VkCommandPool commandPool;  // 指令池对象用于管理指令缓冲对象使用的内存,并负责指令缓冲对象的分配。
-    VkCommandBuffer commandBuffer; // 我们需要将所有要执行的操作记录在一个指令缓冲对象,然后提交给可以执行这些操作的队列
+    // 材质管线: 启动时把所有材质的管线交给编译服务并行编译, 只等待基础管线 (材质 0)。
+    //   其它材质的管线还没编译好 (或编译失败) 时, 使用该材质的绘制退回到基础管线。
+    //   编译任务和每帧的录制任务共用调度器; 主线程等待录制任务时只执行录制任务, 不会顺带执行耗时的编译任务
+    std::unique_ptr<PipelineBuilder> pipelineBuilder;
+    std::vector<PipelineFuture> materialPipelines;  // [材质]
+    std::chrono::steady_clock::time_point pipelineRequestTime;
+    bool materialPipelinesReady = false;  // 所有材质管线都已编译完成 (或失败)
+
+    // 着色器热重载: 重新编译的着色器到达后, 用新的字节码请求全部材质管线, 全部编译完成后在帧之间替换 materialPipelines,
+    //   新的字节码也在这时才替换 vertShaderCode / fragShaderCode。被替换的旧管线放进 retiredPipelines, 等使用它们的帧执行完后释放
+    std::unique_ptr<ShaderWatcher> shaderWatcher;
+    std::vector<PipelineFuture> reloadPipelines;           // 正在编译的新管线, 为空表示没有进行中的重载
+    ShaderCode reloadVertShaderCode;                       // 进行中的重载使用的字节码, 没有修改的阶段和当前的相同
+    ShaderCode reloadFragShaderCode;
+    std::chrono::steady_clock::time_point reloadChangedAt; // 这次重载中最早的一次文件修改时间
+    double reloadCompileMs = 0.0;                          // 这次重载中 glslc 的耗时
+
+    // 不再使用的管线: 图形时间线到达 value 时, 之前提交的帧都已执行完毕 (最多 framesInFlight 帧之后), 可以从注册表释放
+    struct RetiredPipelines {
+        uint64_t value;
+        std::vector<PipelineFuture> pipelines;
+    };
+    std::deque<RetiredPipelines> retiredPipelines;
+
+    VkPipelineCache pipelineCache;      // 管线缓存, 启动时从文件加载, 退出时写回文件
+    bool pipelineCacheLoaded = false;   // 是否成功加载了之前保存的缓存数据
+    std::vector<char> pipelineCacheFileData; // 启动时由加载任务读取的缓存文件内容, 创建管线缓存后释放
+
+    // 着色器字节码, 启动时由加载任务从映射的着色器归档中查找 (直接指向映射的内容), 所有管线描述共用
+    ShaderCode vertShaderCode;
+    ShaderCode fragShaderCode;
+    // 片段着色器的变体声明 (和 shader.frag 中的特化常量对应), 以及应用命令行设置后的基础变体键
+    std::shared_ptr<const ShaderVariants> fragVariants;
+    uint64_t fragVariantKey = 0;
 
-    VkSemaphore imageAvailableSemaphore;
-    VkSemaphore renderFinishedSemaphore;
-    VkFence inFlightFence;
+    VkCommandPool commandPool;  // 指令池对象用于管理指令缓冲对象使用的内存,并负责指令缓冲对象的分配。
+    VkCommandPool transferCommandPool;  // 上传数据用的指令池 (属于传输队列族, 指令缓冲只使用一次)
+    std::vector<VkCommandBuffer> commandBuffers; // 我们需要将所有要执行的操作记录在指令缓冲对象,然后提交给可以执行这些操作的队列 (每个 in-flight 帧一个)
+
+    // 顶点缓冲和索引缓冲 (位于 DEVICE_LOCAL 内存, 通过暂存缓冲上传)
+    VkBuffer vertexBuffer;
+    GpuAllocation vertexBufferAllocation;
+    VkBuffer indexBuffer;
+    GpuAllocation indexBufferAllocation;
+    uint32_t indexCount = 0;
+    std::vector<Vertex> geometryVertices;   // 启动时由任务生成的几何数据, 上传后释放
+    std::vector<uint32_t> geometryIndices;
+    // 几何数据的上传: 上传最后一次提交在图形时间线上的值 (0 表示上传已经完成并释放)。
+    //   上传完成之前暂存缓冲和上传用的指令缓冲不能释放
+    uint64_t geometryUploadValue = 0;
+    VkBuffer geometryStagingBuffer = VK_NULL_HANDLE;
+    GpuAllocation geometryStagingAllocation;
+    VkCommandBuffer geometryUploadCommandBuffer = VK_NULL_HANDLE;   // 传输队列上的拷贝和所有权释放
+    VkCommandBuffer geometryAcquireCommandBuffer = VK_NULL_HANDLE;  // 图形队列上的所有权获取 (没有专用传输队列族时不需要)
+
+    // 每帧的 uniform 数据: 所有绘制共用一个描述符集, 通过动态偏移指向各自在 frameArena 中的数据
+    std::unique_ptr<FrameArena> frameArena;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet frameDescriptorSet;
+    uint32_t staticUniformOffset = 0;  // 静态场景使用的 uniform 数据 (在 frameArena 的持久区域中, 不随帧重置)
+
+    // 绘制列表: 每一项是一次 vkCmdDrawIndexed 调用, 绘制索引缓冲中的一段
+    struct DrawItem {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t material;
+    };
+    std::vector<DrawItem> drawList;
+
+    // 一次渲染流程的目标: 帧缓冲、尺寸和这次绘制使用的 FrameUniforms 偏移
+    struct RenderPassTarget {
+        VkFramebuffer framebuffer;
+        VkExtent2D extent;
+        uint32_t uniformOffset;
+    };
+
+    // 多线程录制: 调度器的每个线程槽位在每个 in-flight 帧拥有一个指令池, 录制任务从执行它的线程的指令池分配辅助指令缓冲
+    struct RecordSlotFrame {
+        VkCommandPool commandPool;
+        std::vector<VkCommandBuffer> secondaryCommandBuffers; // 已经分配的辅助指令缓冲, 指令池重置后可以重新使用
+        size_t usedCount = 0;                                 // 这一帧已经使用的数量
+    };
+    std::vector<std::vector<RecordSlotFrame>> recordSlotFrames; // [线程槽位][in-flight 帧]
+    uint32_t activeRecordThreads = 0;  // 当前把录制拆分成的并行任务数, 0 表示在主线程直接录制
+    double recordMs = 0.0;             // 录制主指令缓冲 (包括等待录制线程) 的累计耗时
+    uint64_t recordCount = 0;
+
+    // GPU 计时 (--gpu-profile): 每个渲染流程和回读拷贝各是一个计时范围, 范围名按渲染流程预先生成
+    std::unique_ptr<GpuProfiler> gpuProfiler;
+    std::vector<std::string> passScopeNames;  // [渲染流程], 0 是主图像, 之后是额外的渲染目标
+    std::chrono::steady_clock::time_point gpuSummaryTime;  // 上一次输出 GPU 耗时摘要的时间
+    std::vector<uint64_t> frameSubmitTicks;  // [in-flight 帧] 提交时的 CPU 时间线计时值, 作为该帧 GPU 范围在时间线中的起点
+
+    // GPU 剔除 (--gpu-cull): 计算着色器 cull.comp 每帧把绘制列表剔除成间接绘制指令, 写入该 in-flight 帧的指令缓冲区。
+    //   有专用计算队列时在计算队列上执行, 和其它帧的绘制并行; 指令缓冲区的所有权在两个队列族之间转移,
+    //   绘制提交在间接绘制阶段等待计算时间线
+    struct CullDraw {  // 和 cull.comp 中的 CullDraw 对应 (std430)
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        glm::vec2 center;  // 绘制的包围圆
+        float radius;
+        float padding;
+    };
+    struct CullParams {  // 和 cull.comp 中的 push constant 块对应
+        glm::mat4 transform;
+        uint32_t drawCount;
+    };
+    struct CullFrame {
+        VkBuffer commands = VK_NULL_HANDLE;  // VkDrawIndexedIndirectCommand[绘制列表长度], 和绘制列表一一对应
+        GpuAllocation commandsAllocation;
+        VkBuffer stats = VK_NULL_HANDLE;     // 可见的绘制数 (主机可见, 该帧执行完毕后读取)
+        GpuAllocation statsAllocation;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        uint64_t value = 0;                  // 这一帧剔除提交的计算时间线值
+        bool pending = false;                // 统计还没有读取
+    };
+    std::vector<CullDraw> cullDraws;         // 和 drawList 一一对应, 上传几何数据时根据顶点计算
+    ShaderCode cullShaderCode;
+    std::unique_ptr<ComputePass> cullPass;
+    // 热重载替换下来的剔除管线: 计算时间线到达 value 时使用它的剔除都已执行完毕, 可以销毁
+    struct RetiredComputePipeline {
+        uint64_t value;
+        VkPipeline pipeline;
+    };
+    std::deque<RetiredComputePipeline> retiredCullPipelines;
+    VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+    VkDescriptorPool cullDescriptorPool = VK_NULL_HANDLE;
+    VkBuffer cullDrawBuffer = VK_NULL_HANDLE;
+    GpuAllocation cullDrawAllocation;
+    std::vector<CullFrame> cullFrames;       // [in-flight 帧]
+    bool multiDrawIndirect = false;          // 设备支持一次间接绘制调用提交多条指令
+    uint32_t maxDrawIndirectCount = 1;       // 一次间接绘制调用最多的指令数 (没有启用 multiDrawIndirect 时必须为 1)
+    uint64_t cullVisibleDraws = 0;           // 所有已读取统计的帧中可见的绘制数之和
+    uint64_t cullFrameCount = 0;
+
+    // 每个 in-flight 帧拥有自己的一组同步对象, 这样 CPU 准备下一帧时不需要等待 GPU 完成当前帧
+    std::vector<VkSemaphore> imageAvailableSemaphores;
+    // [交换链图像] 呈现等待的信号量按图像索引: 时间线只说明提交已经执行完, 不说明呈现已经消耗了信号量,
+    //   只有再次获取到同一张图像时才能确定上一次呈现已经等待过它 (无窗口模式下为空)
+    std::vector<VkSemaphore> renderFinishedSemaphores;
+    std::vector<uint64_t> frameTimelineValues; // [in-flight 帧] 该帧最近一次提交的图形时间线值, 0 表示还没有提交过
+    std::vector<uint64_t> imageTimelineValues; // [交换链图像] 最近一次使用该图像的提交的时间线值 (交换链图像数可能和 in-flight 帧数不同)
+    uint32_t currentFrame = 0;           // 当前使用的 in-flight 帧的索引
+    uint32_t framesInFlight = 0;         // 实际使用的 in-flight 帧数 (<= options.maxFramesInFlight, 测试模式下会临时改为 1)
+
+    // 静态场景模式: 每个交换链帧缓冲对应一个预先录制好的指令缓冲, 绘制内容不变时直接重复提交
+    std::vector<VkCommandBuffer> sceneCommandBuffers;
+    std::vector<bool> sceneCommandBufferDirty; // 对应的指令缓冲需要在下次使用前重新录制
+    uint64_t sceneRecordCount = 0;             // 静态场景指令缓冲的录制次数 (含首次录制)
+    uint64_t frameCount = 0;                   // 已提交的帧数
+
+    bool framebufferResized = false;           // 窗口尺寸改变, 需要重建交换链
+    FramePacer framePacer;                     // 主循环的限速和帧节奏统计
+    std::vector<double> swapChainRecreateMs;   // 每次重建交换链的耗时 (包括等待设备空闲的时间)
+
+    // 帧回读: 主机可见的暂存缓冲环。每帧绘制结束后把离屏图像拷贝到一个空闲的暂存缓冲, 该帧的提交执行完毕后交给编码线程保存,
+    //   编码完成后缓冲重新变为空闲。没有空闲缓冲时 (编码线程跟不上) 直接丢弃这一帧的回读, 渲染线程从不等待编码线程。
+    struct ReadbackBuffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        GpuAllocation allocation;
+        void* mapped = nullptr;             // 持久映射的地址 (分配器映射的主机可见内存)
+        std::atomic<bool> available{true};  // 由编码线程在保存完成后置为 true
+    };
+    std::vector<ReadbackBuffer> readbackBuffers;
+    std::vector<int> frameReadbackBuffers;   // 每个 in-flight 帧正在写入的暂存缓冲索引, -1 表示该帧没有回读
+    std::vector<uint64_t> frameReadbackIndices; // 每个 in-flight 帧对应的帧序号
+    std::unique_ptr<FrameEncoder> frameEncoder;
+    uint64_t readbackDropped = 0;            // 因为没有空闲暂存缓冲而丢弃的帧数
 
     void initWindow() {
+        if (options.headless) {
+            return;
+        }
+
         glfwInit();
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
-        window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+        window = glfwCreateWindow(options.width, options.height, "Vulkan", nullptr, nullptr);
+        glfwSetWindowUserPointer(window, this);
+        glfwSetKeyCallback(window, keyCallback);
+        glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
     }
 
+    // 窗口尺寸改变时, 驱动不一定会在 vkAcquireNextImageKHR/vkQueuePresentKHR 返回 VK_ERROR_OUT_OF_DATE_KHR, 所以我们自己记录下来
+    static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        app->framebufferResized = true;
+    }
+
+    static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+            app->markSceneDirty();
+        }
+    }
+
+    // 场景内容发生变化, 所有预先录制的指令缓冲在下次使用前都需要重新录制
+    void markSceneDirty() {
+        std::fill(sceneCommandBufferDirty.begin(), sceneCommandBufferDirty.end(), true);
+    }
+
+    // 初始化以任务图的形式进行: 不依赖 Vulkan 对象的工作 (读取着色器和管线缓存文件、生成几何数据) 作为任务提交给调度器,
+    //   和主线程上实例、设备、交换链的创建并行执行; 主线程在真正需要这些数据之前等待对应的计数器。
     void initVulkan() {
+        auto start = std::chrono::steady_clock::now();
+
+        TaskCounter shadersLoaded;
+        TaskCounter pipelineCacheFileLoaded;
+        TaskCounter geometryGenerated;
+        scheduler->submit([this] { loadShaders(); }, &shadersLoaded);
+        scheduler->submit([this] { pipelineCacheFileData = readPipelineCacheFile(); }, &pipelineCacheFileLoaded);
+        scheduler->submit([this] { generateGeometry(options.triangles, geometryVertices, geometryIndices); }, &geometryGenerated);
+
         createInstance();
         setupDebugMessenger();
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
-        createSwapChain();
+        if (options.headless) {
+            createOffscreenImages();
+        } else {
+            createSwapChain();
+        }
         createImageViews();
+        scheduler->wait(pipelineCacheFileLoaded);
+        createPipelineCache();
         createRenderPass();
+        createExtraTargets();
+        createDescriptorSetLayout();
+        scheduler->wait(shadersLoaded);
         createGraphicsPipeline();
+        savePipelineCache();  // 启动后立即保存一次, 即使进程之后被直接杀掉, 下次启动也能使用缓存
         createFramebuffers();
         createCommandPool();
-        createCommandBuffer();
+        scheduler->wait(geometryGenerated);
+        createGeometryBuffers();
+        createFrameArena();
+        createCommandBuffers();
+        createRecordCommandPools();
         createSyncObjects();
+        createReadbackBuffers();
+        createCullPass();
+        if (options.gpuProfile) {
+            createGpuProfiler();
+        }
+        if (options.watchShaders) {
+            shaderWatcher.reset(new ShaderWatcher(TEST_SRC_PATH, {"shader.vert", "shader.frag", "cull.comp"}, TEST_BIN_PATH,
+                                                  SHADER_ARCHIVE_FILE));
+        }
+
+        std::cout << "latency policy: " << latencyPolicyName(options.latencyPolicy) << " (from " << options.latencyPolicySource << "), "
+                  << swapChainImages.size() << (options.headless ? " offscreen images, " : " swap chain images, ")
+                  << options.maxFramesInFlight << " frames in flight";
+        if (!options.headless) {
+            std::cout << ", present mode " << presentModeName(swapChainPresentMode);
+        }
+        std::cout << std::endl;
+        std::cout << "vulkan initialized in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                  << " ms (" << scheduler->workerCount() << " worker threads)" << std::endl;
+    }
+
+    // 是否应该结束主循环
+    bool shouldStop() {
+        if (options.maxFrames > 0 && frameCount >= options.maxFrames) {
+            return true;
+        }
+        return !options.headless && glfwWindowShouldClose(window);
     }
 
     void mainLoop() {
-        while (!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
-            drawFrame();
+        auto start = std::chrono::steady_clock::now();
+
+        while (!shouldStop()) {
+            pacedFrame();
+
+            if (gpuProfiler && std::chrono::steady_clock::now() - gpuSummaryTime >= std::chrono::seconds(1)) {
+                gpuProfiler->printSummary(std::cout);
+                gpuSummaryTime = std::chrono::steady_clock::now();
+            }
         }
 
         // 等待逻辑设备的操作结束执行才能退出
         //     因为drawFrame 函数中的操作是异步执行的。这意味着我们关闭应用程序窗口跳出主循环时,绘制操作和呈现操作可能仍在继续执行,
         //     这与我们紧接着进行的清除操作也是冲突的。
         vkDeviceWaitIdle(device);
+
+        if (options.headless) {
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "headless: " << frameCount << " frames in " << ms << " ms, " << frameCount * 1000.0 / ms << " fps, "
+                      << static_cast<double>(frameCount) * (indexCount / 3) / (ms * 1000.0) << " Mtri/s" << std::endl;
+        }
+
+        finishReadback(start);
     }
 
-    void cleanup() {
-        vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
-        vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
-        vkDestroyFence(device, inFlightFence, nullptr);
+    // 打印运行期间的统计信息
+    void reportStatistics() {
+        allocator->printStats(std::cout);
 
-        vkDestroyCommandPool(device, commandPool, nullptr);
+        if (!swapChainRecreateMs.empty()) {
+            std::vector<double> sorted = swapChainRecreateMs;
+            std::sort(sorted.begin(), sorted.end());
+            double total = 0.0;
+            for (double ms : sorted) {
+                total += ms;
+            }
+            std::cout << "swap chain recreated " << sorted.size() << " times, stall avg " << total / sorted.size()
+                      << " ms, p50 " << sorted[sorted.size() / 2] << " ms, max " << sorted.back() << " ms" << std::endl;
+        }
 
+        if (recordCount > 0 && options.recordBenchmark == 0) {
+            std::cout << "command recording: " << recordMs / recordCount << " ms/frame avg, " << drawList.size() << " draws, "
+                      << activeRecordThreads << " record threads" << std::endl;
+        }
+
+        PipelineRegistryStats pipelineStats = pipelineBuilder->stats();
+        std::cout << "pipeline registry: " << pipelineStats.requests << " requests, " << pipelineStats.hits << " hits, "
+                  << pipelineStats.misses << " misses (" << pipelineBuilder->builtCount() << " pipelines), "
+                  << pipelineStats.renderPassClasses << " render pass classes" << std::endl;
+
+        FramePacingStats pacing = framePacer.stats();
+        if (pacing.frames > 0 && options.pacingCompare == 0) {
+            std::string mode = options.headless ? "headless" : presentModeName(swapChainPresentMode);
+            printFramePacing(mode, pacing);
+            if (!options.pacingCsv.empty()) {
+                appendFramePacingCsv(options.pacingCsv, mode, static_cast<uint32_t>(swapChainImages.size()), options.targetFps, pacing);
+            }
+        }
+
+        if (gpuProfiler) {
+            // 所有帧都已执行完毕 (主循环结束时等待了设备空闲), 读回最后几帧的结果
+            for (uint32_t i = 0; i < options.maxFramesInFlight; i++) {
+                gpuProfiler->collect(i);
+            }
+            gpuProfiler->printReport(std::cout);
+        }
+
+        if (cullPass) {
+            for (uint32_t i = 0; i < cullFrames.size(); i++) {
+                collectCullStats(i);
+            }
+            if (cullFrameCount > 0) {
+                double visible = static_cast<double>(cullVisibleDraws) / cullFrameCount;
+                std::cout << "gpu culling: " << visible << " of " << drawList.size() << " draws visible per frame ("
+                          << 100.0 * visible / std::max<size_t>(drawList.size(), 1) << "%)" << std::endl;
+            }
+        }
+
+        std::cout << "frame arena: peak " << frameArena->peakBytes() << " of " << frameArena->bytesPerFrame()
+                  << " bytes per frame" << std::endl;
+
+        if (options.staticScene) {
+            std::cout << "static scene: " << frameCount << " frames, command buffers recorded " << sceneRecordCount
+                      << " times (" << swapChainImages.size() << " initial, "
+                      << sceneRecordCount - std::min<uint64_t>(sceneRecordCount, swapChainImages.size()) << " re-records)" << std::endl;
+        }
+    }
+
+    // 销毁依赖交换链图像的对象 (渲染流程和管线不依赖交换链的尺寸, 可以保留)
+    void cleanupSwapChain() {
         for (auto framebuffer : swapChainFramebuffers) {
             vkDestroyFramebuffer(device, framebuffer, nullptr);
         }
+        swapChainFramebuffers.clear();
+
+        for (auto imageView : swapChainImageViews) {
+            vkDestroyImageView(device, imageView, nullptr);
+        }
+        swapChainImageViews.clear();
+    }
+
+    // 重建交换链 (窗口尺寸改变或交换链不再和表面匹配时)
+    //   只重建交换链、图像视图和帧缓冲。视口和裁剪是动态状态, 所以渲染流程和管线可以继续使用;
+    //   旧交换链通过 oldSwapchain 传给新交换链, 驱动可以复用它的资源, 正在呈现的图像也可以正常完成。
+    void recreateSwapChain() {
+        // 窗口最小化时帧缓冲尺寸为 0, 等待窗口恢复
+        int width = 0, height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        while (width == 0 || height == 0) {
+            glfwGetFramebufferSize(window, &width, &height);
+            glfwWaitEvents();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        // 等待正在使用旧交换链图像的帧结束
+        vkDeviceWaitIdle(device);
+
+        cleanupSwapChain();
+
+        VkSwapchainKHR oldSwapChain = swapChain;
+        VkFormat oldFormat = swapChainImageFormat;
+        createSwapChain(oldSwapChain);
+        vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+
+        // 表面格式一般不会改变; 如果改变了, 渲染流程和管线也需要重建。
+        //   还在排队或编译的管线 (包括进行中的热重载) 会读取旧的渲染流程, 必须等它们结束后才能销毁;
+        //   进行中的热重载的管线和新渲染流程不兼容, 用重载的字节码按新渲染流程重新请求
+        if (swapChainImageFormat != oldFormat) {
+            pipelineBuilder->waitAll();
+            vkDestroyRenderPass(device, renderPass, nullptr);
+            createRenderPass();
+            requestMaterialPipelines();
+            if (!reloadPipelines.empty()) {
+                requestReloadPipelines();
+            }
+        }
+
+        createImageViews();
+        createFramebuffers();
+
+        // 交换链图像数可能改变, 重置图像和帧的对应关系; 图像数改变时按新的图像数重建呈现信号量 (设备已经空闲)
+        imageTimelineValues.assign(swapChainImages.size(), 0);
+        if (renderFinishedSemaphores.size() != swapChainImages.size()) {
+            destroyRenderFinishedSemaphores();
+            createRenderFinishedSemaphores();
+        }
+
+        // 静态场景的指令缓冲引用了旧的帧缓冲, 需要重新录制
+        if (options.staticScene) {
+            vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(sceneCommandBuffers.size()), sceneCommandBuffers.data());
+            allocateSceneCommandBuffers();
+        }
+
+        framebufferResized = false;
+        swapChainRecreateMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    void cleanup() {
+        frameEncoder.reset();  // 先结束编码线程, 它可能还在读取暂存缓冲
+        gpuProfiler.reset();
+        shaderWatcher.reset();
+        destroyCullPass();
+        pipelineBuilder.reset();  // 等待还在编译的管线, 并销毁注册表中的所有管线 (需要调度器)
+        scheduler.reset();
+        for (auto& slotFrames : recordSlotFrames) {
+            for (auto& slotFrame : slotFrames) {
+                vkDestroyCommandPool(device, slotFrame.commandPool, nullptr);  // 指令池销毁时, 从中分配的指令缓冲也被释放
+            }
+        }
+        for (auto& readback : readbackBuffers) {
+            allocator->destroyBuffer(readback.buffer, readback.allocation);
+        }
+
+        for (VkSemaphore semaphore : imageAvailableSemaphores) {
+            vkDestroySemaphore(device, semaphore, nullptr);
+        }
+        destroyRenderFinishedSemaphores();
+        releaseGeometryUpload(true);
+        ownedComputeTimeline.reset();
+        ownedTransferTimeline.reset();
+        graphicsTimeline.reset();
+
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        frameArena.reset();
+
+        allocator->destroyBuffer(indexBuffer, indexBufferAllocation);
+        allocator->destroyBuffer(vertexBuffer, vertexBufferAllocation);
+
+        vkDestroyCommandPool(device, transferCommandPool, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+
+        cleanupSwapChain();
 
-        vkDestroyPipeline(device, graphicsPipeline, nullptr);
         vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+        savePipelineCache();
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
         vkDestroyRenderPass(device, renderPass, nullptr);
 
-        for (auto imageView : swapChainImageViews) {
-            vkDestroyImageView(device, imageView, nullptr);
+        for (auto& target : extraTargets) {
+            for (size_t i = 0; i < target.images.size(); i++) {
+                vkDestroyFramebuffer(device, target.framebuffers[i], nullptr);
+                vkDestroyImageView(device, target.imageViews[i], nullptr);
+                allocator->destroyImage(target.images[i], target.allocations[i]);
+            }
         }
 
-        vkDestroySwapchainKHR(device, swapChain, nullptr);
+        if (options.headless) {
+            for (size_t i = 0; i < swapChainImages.size(); i++) {
+                allocator->destroyImage(swapChainImages[i], offscreenImageAllocations[i]);
+            }
+        } else {
+            vkDestroySwapchainKHR(device, swapChain, nullptr);
+        }
+        allocator.reset();
         vkDestroyDevice(device, nullptr);
 
         if (enableValidationLayers) {
             DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
         }
 
-        vkDestroySurfaceKHR(instance, surface, nullptr);
+        if (!options.headless) {
+            vkDestroySurfaceKHR(instance, surface, nullptr);
+        }
 
         // 使用Vulkan API创建的对象应该在 Vulkan实例 清除之前被清除。
         vkDestroyInstance(instance, nullptr);
 
-        glfwDestroyWindow(window);
+        if (!options.headless) {
+            glfwDestroyWindow(window);
 
-        glfwTerminate();
+            glfwTerminate();
+        }
     }
 
     // 创建实例
@@ -196,7 +1069,7 @@ private:
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        appInfo.apiVersion = VK_API_VERSION_1_2;  // 帧和上传的同步使用时间线信号量 (Vulkan 1.2 核心功能)
 
         VkInstanceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -230,6 +1103,12 @@ private:
     void createLogicalDevice() {
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
         std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()}; //使用set对索引号去重
+        if (indices.transferFamily.has_value()) {
+            uniqueQueueFamilies.insert(indices.transferFamily.value());
+        }
+        if (indices.computeFamily.has_value()) {
+            uniqueQueueFamilies.insert(indices.computeFamily.value());
+        }
         
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         float queuePriority = 1.0f; //// Vulkan 需要我们赋予队列一个 0.0 到 1.0 之间的浮点数作为优先级来控制指令缓冲的执行顺序。即使只有一个队列,我们也要显式地赋予队列优先级
@@ -244,16 +1123,30 @@ private:
 
         // 指定应用程序使用的设备特性: todo
         VkPhysicalDeviceFeatures deviceFeatures{};
+        // GPU 剔除时每个材质的一段绘制用一次间接绘制调用提交, 不支持时退回到每次绘制一次调用
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+        multiDrawIndirect = options.gpuCull && supportedFeatures.multiDrawIndirect;
+        deviceFeatures.multiDrawIndirect = multiDrawIndirect ? VK_TRUE : VK_FALSE;
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+        maxDrawIndirectCount = multiDrawIndirect ? std::max(deviceProperties.limits.maxDrawIndirectCount, 1u) : 1;
+        // Vulkan 1.2 的特性通过 pNext 链指定 (isDeviceSuitable 已经检查过设备支持)
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12Features.timelineSemaphore = VK_TRUE;
 
         // 和 Vulkan 实例一样，设备也需要设置扩展和校验层，注意只需要设置针对设备的那些扩展;
         // 创建逻辑设备时指定的队列会随着逻辑设备一同被创建。
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = &vulkan12Features;
         createInfo.pQueueCreateInfos = queueCreateInfos.data();  //队列信息
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pEnabledFeatures = &deviceFeatures; //设备feature
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()); //设备扩展
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        auto extensions = getDeviceExtensions();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size()); //设备扩展
+        createInfo.ppEnabledExtensionNames = extensions.data();
 
         // 我们可以对设备和 Vulkan 实例使用相同的校验层,不需要额外的扩展支持
         if (enableValidationLayers) {
@@ -272,16 +1165,44 @@ private:
         // 因为,我们每个队列族只创建了一个队列,所以,可以直接使用索引 0 调用函数:
         vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
         vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+        vkGetDeviceQueue(device, indices.transferFamily.value_or(indices.graphicsFamily.value()), 0, &transferQueue);
+        vkGetDeviceQueue(device, indices.computeFamily.value_or(indices.graphicsFamily.value()), 0, &computeQueue);
+
+        // 同一个队列只有一条时间线
+        graphicsTimeline.reset(new QueueTimeline(device, graphicsQueue));
+        transferTimeline = graphicsTimeline.get();
+        if (transferQueue != graphicsQueue) {
+            ownedTransferTimeline.reset(new QueueTimeline(device, transferQueue));
+            transferTimeline = ownedTransferTimeline.get();
+        }
+        computeTimeline = graphicsTimeline.get();
+        if (computeQueue != graphicsQueue) {
+            ownedComputeTimeline.reset(new QueueTimeline(device, computeQueue));
+            computeTimeline = ownedComputeTimeline.get();
+        }
+
+        auto familyName = [&](const std::optional<uint32_t>& family) {
+            return family.has_value() ? "family " + std::to_string(family.value()) + " (dedicated)" : std::string("graphics queue");
+        };
+        std::cout << "queues: graphics family " << indices.graphicsFamily.value() << ", present family " << indices.presentFamily.value()
+                  << ", transfer " << familyName(indices.transferFamily) << ", compute " << familyName(indices.computeFamily) << std::endl;
+
+        allocator.reset(new GpuAllocator(physicalDevice, device));
     }
 
-    void createSwapChain() {
+    // oldSwapChain: 重建交换链时传入旧的交换链, 初次创建时为 VK_NULL_HANDLE
+    void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE) {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats); // 表面格式
         VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);  // 呈现模式
         VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);  // 分辨率
 
-        uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1; // 使用"最小图像个数 +1" 数量的图像来实现三倍缓冲 (猜测：最小图像个数 >= 2)
+        // 图像数由延迟策略决定: 默认 (balanced) 使用"最小图像个数 +1" 数量的图像来实现三倍缓冲 (猜测：最小图像个数 >= 2)
+        uint32_t imageCount = swapChainSupport.capabilities.minImageCount + latencyPolicySettings(options.latencyPolicy).extraSwapChainImages;
+        if (options.swapChainImages > 0) {
+            imageCount = std::max(options.swapChainImages, swapChainSupport.capabilities.minImageCount);
+        }
         // imageCount不要超过最大值
         // (注：maxImageCount 的值为 0 表明,只要内存可以满足,我们可以使用任意数量的图像。)
         if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
@@ -317,10 +1238,11 @@ private:
         // 指定 alpha 通道是否被用来和窗口系统中的其它窗口进行混合操作。通常,我们将其设置为 VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR 来忽略掉 alpha 通道。
         createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         createInfo.presentMode = presentMode;
+        swapChainPresentMode = presentMode;
         // clipped 成员变量被设置为VK_TRUE 表示我们不关心被窗口系统中的其它窗口遮挡的像素的颜色,这允许 Vulkan 采取一定的优化措施,但如果我们回读窗口的像素值就可能出现问题。
         createInfo.clipped = VK_TRUE;
 
-        createInfo.oldSwapchain = VK_NULL_HANDLE;  // 用于交换链的重建
+        createInfo.oldSwapchain = oldSwapChain;  // 用于交换链的重建
 
         if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
             throw std::runtime_error("failed to create swap chain!");
@@ -338,31 +1260,86 @@ private:
         swapChainExtent = extent;
     }
 
+    // 无窗口模式: 创建离屏图像代替交换链图像, 每个 in-flight 帧使用一张, 避免不同帧写同一张图像
+    void createOffscreenImages() {
+        swapChainImageFormat = OFFSCREEN_FORMAT;
+        swapChainExtent = {options.width, options.height};
+        swapChainImages.resize(options.maxFramesInFlight);
+        offscreenImageAllocations.resize(options.maxFramesInFlight);
+
+        for (uint32_t i = 0; i < options.maxFramesInFlight; i++) {
+            createOffscreenImage(swapChainExtent, swapChainImages[i], offscreenImageAllocations[i]);
+        }
+    }
+
+    // 创建额外的渲染目标 (需要在渲染流程创建之后)
+    void createExtraTargets() {
+        for (const VkExtent2D& extent : options.extraTargets) {
+            ExtraTarget target;
+            target.extent = extent;
+            target.images.resize(options.maxFramesInFlight);
+            target.allocations.resize(options.maxFramesInFlight);
+            target.imageViews.resize(options.maxFramesInFlight);
+            target.framebuffers.resize(options.maxFramesInFlight);
+
+            for (uint32_t i = 0; i < options.maxFramesInFlight; i++) {
+                createOffscreenImage(extent, target.images[i], target.allocations[i]);
+                target.imageViews[i] = createImageView(target.images[i], OFFSCREEN_FORMAT);
+                target.framebuffers[i] = createFramebuffer(target.imageViews[i], extent);
+            }
+            extraTargets.push_back(target);
+        }
+    }
+
+    // 创建一张可以作为颜色附着的离屏图像, 并为它分配设备内存
+    void createOffscreenImage(VkExtent2D extent, VkImage& image, GpuAllocation& allocation) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = OFFSCREEN_FORMAT;
+        imageInfo.extent = {extent.width, extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // 作为颜色附着绘制, 之后可以拷贝出来回读
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        allocator->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, allocation);
+    }
+
     // 创建图像视图
     // 使用任何 VkImage 对象,包括处于交换链中的,处于渲染管线中的,都需要我们创建一个 VkImageView 对象来绑定访问它。
     void createImageViews() {
         swapChainImageViews.resize(swapChainImages.size());
 
         for (size_t i = 0; i < swapChainImages.size(); i++) {
-            VkImageViewCreateInfo createInfo{};
-            createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-            createInfo.image = swapChainImages[i];
-            createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D; // 指定图像被看作是一维纹理、二维纹理、三维纹理还是立方体贴图
-            createInfo.format = swapChainImageFormat;
-            createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;  // components成员用于进行图像颜色通道的映射
-            createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-            createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-            createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-            createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT; // subresourceRange 成员变量用于指定图像的用途和图像的哪一部分可以被访问
-            createInfo.subresourceRange.baseMipLevel = 0;
-            createInfo.subresourceRange.levelCount = 1;
-            createInfo.subresourceRange.baseArrayLayer = 0;
-            createInfo.subresourceRange.layerCount = 1;
+            swapChainImageViews[i] = createImageView(swapChainImages[i], swapChainImageFormat);
+        }
+    }
 
-            if (vkCreateImageView(device, &createInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create image views!");
-            }
+    VkImageView createImageView(VkImage image, VkFormat format) {
+        VkImageViewCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        createInfo.image = image;
+        createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D; // 指定图像被看作是一维纹理、二维纹理、三维纹理还是立方体贴图
+        createInfo.format = format;
+        createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;  // components成员用于进行图像颜色通道的映射
+        createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT; // subresourceRange 成员变量用于指定图像的用途和图像的哪一部分可以被访问
+        createInfo.subresourceRange.baseMipLevel = 0;
+        createInfo.subresourceRange.levelCount = 1;
+        createInfo.subresourceRange.baseArrayLayer = 0;
+        createInfo.subresourceRange.layerCount = 1;
+
+        VkImageView imageView;
+        if (vkCreateImageView(device, &createInfo, nullptr, &imageView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create image views!");
         }
+        return imageView;
     }
 
     // 创建渲染流程
@@ -375,7 +1352,8 @@ private:
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;   // 指定在渲染之前对附着中的数据进行的操作。(用于模板缓冲)
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; // 指定在渲染之后对附着中的数据进行的操作。(用于模板缓冲)
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;     // 指定渲染流程开始前的图像布局方式
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // 指定渲染流程结束后的图像布局方式
+        // 指定渲染流程结束后的图像布局方式 (无窗口模式下不需要呈现, 转换为便于拷贝回读的布局)
+        colorAttachment.finalLayout = options.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         VkAttachmentReference colorAttachmentRef{};
         colorAttachmentRef.attachment = 0;  // 指定要引用的附着在附着描述结构体数组中的索引。 这里设置的颜色附着在数组中的索引会被片段着色器使用,
@@ -396,203 +1374,1019 @@ private:
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
 
+        // 无窗口模式下, 渲染流程结束后会把图像拷贝到暂存缓冲。
+        //   需要保证颜色附着的写入和结束时的布局转换完成后, 拷贝操作才开始读取图像。
+        VkSubpassDependency dependency{};
+        dependency.srcSubpass = 0;
+        dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        if (options.headless) {
+            renderPassInfo.dependencyCount = 1;
+            renderPassInfo.pDependencies = &dependency;
+        }
+
         if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
             throw std::runtime_error("failed to create render pass!");
         }
+        pipelineBuilder->registerRenderPass(renderPass, renderPassInfo);
     }
 
-    // 创建图形管线
-    void createGraphicsPipeline() {
-        auto vertShaderCode = readFile(TEST_BIN_PATH "/shader.vert.spv");
-        auto fragShaderCode = readFile(TEST_BIN_PATH "/shader.frag.spv");
-
-        VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-        VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-        VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;  // 指定着色器在管线的哪一阶段被使用
-        vertShaderStageInfo.module = vertShaderModule; // 指定使用的着色器模块对象
-        vertShaderStageInfo.pName = "main";  // 指定调用的着色器函数 (在同一份代码中可以实现多个片段着色器,然后通过不同的 "函数名" 调用它们)
-        vertShaderStageInfo.pSpecializationInfo = nullptr; // 可以通过这一成员变量指定着色器用到的常量, 我们可以对同一个着色器模块对象指定不同
-                                                           // 的着色器常量用于管线创建,这使得编译器可以根据指定的着色器常量来消除一些条件分支,这比在渲染
-                                                           // 时,使用变量配置着色器带来的效率要高得多。如果不使用着色器常量,可以将它设置为 nullptr。
-                                                           // （理解：类似设置给shader设置Uniform常量）
-
-        VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragShaderStageInfo.module = fragShaderModule;
-        fragShaderStageInfo.pName = "main";
-        fragShaderStageInfo.pSpecializationInfo = nullptr;
-
-        VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
-
-        // 顶点输入 (描述传递给顶点着色器的顶点数据格式)
-        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputInfo.vertexBindingDescriptionCount = 0; // 由于我们直接在顶点着色器中硬编码顶点数据,所以我们填写结构体信息时指定不载入任何顶点数据。
-        vertexInputInfo.pVertexBindingDescriptions = nullptr;
-        vertexInputInfo.vertexAttributeDescriptionCount = 0; // 由于我们直接在顶点着色器中硬编码顶点数据,所以我们填写结构体信息时指定不载入任何顶点数据。
-        vertexInputInfo.pVertexAttributeDescriptions = nullptr;
-
-        // 输入装配 (描述两个信息:顶点数据定义了哪种类型的几何图元,以及是否启用几何图元重启)
-        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;  // 每三个顶点构成一个三角形图元
-        inputAssembly.primitiveRestartEnable = VK_FALSE; // 用于带有 _STRIP 结尾的图元类型
-
-        // 视口和裁剪 （可以使用多个视口和裁剪矩形）
-        // 视口： 定义了图像到帧缓冲的映射关系
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        // 需要注意,交换链图像的大小可能与窗口大小不同。交换链图像在之后会被用作帧缓冲,所以这里我们设置视口大小为交换链图像的大小。
-        viewport.width = (float) swapChainExtent.width;
-        viewport.height = (float) swapChainExtent.height;
-        viewport.minDepth = 0.0f;  // 指定帧缓冲使用的深度值的范围
-        viewport.maxDepth = 1.0f;
+    // 检查管线缓存数据的头部是否和当前设备匹配。
+    //   缓存数据以 VkPipelineCacheHeaderVersionOne 开头, 厂商ID、设备ID 或 pipelineCacheUUID (驱动版本变化时会改变) 不一致时,
+    //   缓存数据对当前设备无效, 应该丢弃。
+    bool isPipelineCacheCompatible(const std::vector<char>& data) {
+        if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne)) {
+            return false;
+        }
 
-        // 裁剪： 定义了哪一区域的像素实际vertexInputInfo被存储在帧缓存。任何位于裁剪矩形外的像素都会被光栅化程序丢弃。
-        VkRect2D scissor{};
-        scissor.offset = {0, 0};
-        scissor.extent = swapChainExtent; // 在本教程,我们在整个帧缓冲上进行绘制操作,所以将裁剪范围设置为和帧缓冲大小一样
-
-        VkPipelineViewportStateCreateInfo viewportState{};
-        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        viewportState.viewportCount = 1; // 视口数量
-        viewportState.pViewports = &viewport;
-        viewportState.scissorCount = 1; // 裁剪数量
-        viewportState.pScissors = &scissor;
-
-        // 光栅化
-        VkPipelineRasterizationStateCreateInfo rasterizer{};
-        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-        rasterizer.depthClampEnable = VK_FALSE; // VK_TRUE 表示在近平面和远平面外的片段会被截断为在近平面和远平面上,而不是直接丢弃这些片段。
-                                                // 这对于阴影贴图的生成很有用。使用这一设置需要开启相应的 GPU 特性。
-        rasterizer.rasterizerDiscardEnable = VK_FALSE;  // VK_TRUE 表示所有几何图元都不能通过光栅化阶段。这一设置会禁止一切片段输出到帧缓冲。
-        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;  // 指定几何图元生成片段的方式： VK_POLYGON_MODE_FILL表示整个多边形,包括多边形内部都产生片段
-        rasterizer.lineWidth = 1.0f;  // lineWidth 成员变量用于指定光栅化后的线段宽度,它以线宽所占的片段数目为单位。
-                                      // 线宽的最大值依赖于硬件,使用大于 1.0f 的线宽,需要启用相应的 GPU 特性。
-        rasterizer.cullMode = VK_CULL_MODE_BACK_BIT; // 指定使用的表面剔除类型
-        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE; // 指定顺时针的顶点序是正面,还是逆时针的顶点序是正面
-        rasterizer.depthBiasEnable = VK_FALSE;  // 光栅化程序可以添加一个常量值或是一个基于片段所处线段的斜率得到的变量值到深度值上。
-                                                // 这对于阴影贴图会很有用,但在这里,我们不使用它,所以将 depthBiasEnable 成员变量设置为 VK_FALSE。
-
-        // 多重采样
-        // 多重采样是一种组合多个不同多边形产生的片段的颜色来决定最终的像素颜色的技术,它可以一定程度上减少多边形边缘的走样现象。
-        VkPipelineMultisampleStateCreateInfo multisampling{};
-        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-        // 颜色混合
-        // 片段着色器返回的片段颜色需要和原来帧缓冲中对应像素的颜色进行混合。混合的方式有下面两种:
-        //    1) 混合旧值和新值产生最终的颜色
-        //    2) 使用位运算组合旧值和新值
-        // 通常,我们使用颜色混合是为了进行 alpha 混合来实现半透明效果。
-        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        colorBlendAttachment.blendEnable = VK_FALSE; // VK_FALSE,就不会进行混合操作。否则,就会执行指定的混合操作计算新的颜色值。计算出的新的颜色
-                                                     // 值会按照 colorWriteMask 的设置决定写入到帧缓冲的颜色通道。
-
-        VkPipelineColorBlendStateCreateInfo colorBlending{};
-        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        colorBlending.logicOpEnable = VK_FALSE;
-        colorBlending.logicOp = VK_LOGIC_OP_COPY;
-        colorBlending.attachmentCount = 1;
-        colorBlending.pAttachments = &colorBlendAttachment;
-        colorBlending.blendConstants[0] = 0.0f;
-        colorBlending.blendConstants[1] = 0.0f;
-        colorBlending.blendConstants[2] = 0.0f;
-        colorBlending.blendConstants[3] = 0.0f;
+        VkPipelineCacheHeaderVersionOne header;
+        memcpy(&header, data.data(), sizeof(header));
+
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+        return header.headerSize >= sizeof(VkPipelineCacheHeaderVersionOne) &&
+               header.headerSize <= data.size() &&
+               header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+               header.vendorID == deviceProperties.vendorID &&
+               header.deviceID == deviceProperties.deviceID &&
+               memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    // 读取管线缓存文件, 文件不存在或读取失败时返回空数据 (不访问 Vulkan 对象, 可以在任务中执行)
+    static std::vector<char> readPipelineCacheFile() {
+        std::vector<char> cacheData;
+        std::ifstream file(PIPELINE_CACHE_FILE, std::ios::ate | std::ios::binary);
+        if (file.is_open()) {
+            cacheData.resize((size_t) file.tellg());
+            file.seekg(0);
+            file.read(cacheData.data(), cacheData.size());
+            if (!file) {
+                cacheData.clear();
+            }
+        }
+        return cacheData;
+    }
+
+    // 创建管线缓存, 如果缓存文件存在且和当前设备匹配, 就用它作为初始数据
+    void createPipelineCache() {
+        std::vector<char> cacheData = std::move(pipelineCacheFileData);
+
+        pipelineCacheLoaded = false;
+        if (!cacheData.empty()) {
+            if (isPipelineCacheCompatible(cacheData)) {
+                pipelineCacheLoaded = true;
+            } else {
+                std::cout << "pipeline cache: ignoring incompatible cache file " << PIPELINE_CACHE_FILE << std::endl;
+                cacheData.clear();
+            }
+        }
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = cacheData.size();
+        cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+        if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+        pipelineBuilder.reset(new PipelineBuilder(device, *scheduler, pipelineCache));
+
+        std::cout << "pipeline cache: " << (pipelineCacheLoaded ? "loaded " + std::to_string(cacheData.size()) + " bytes" : std::string("empty"))
+                  << std::endl;
+    }
+
+    // 将管线缓存数据写回文件。
+    //   先写入临时文件, 再用 rename 替换原文件 (同一文件系统内 rename 是原子操作), 这样进程中途退出时不会留下写了一半的缓存文件。
+    void savePipelineCache() {
+        size_t dataSize = 0;
+        if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+            return;
+        }
+        std::vector<char> data(dataSize);
+        if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+            return;
+        }
+
+        std::string tmpFile = PIPELINE_CACHE_FILE + ".tmp";
+        {
+            std::ofstream file(tmpFile, std::ios::binary | std::ios::trunc);
+            file.write(data.data(), dataSize);
+            file.close();
+            if (!file) {
+                std::cerr << "pipeline cache: failed to write " << tmpFile << std::endl;
+                std::remove(tmpFile.c_str());
+                return;
+            }
+        }
+
+        if (std::rename(tmpFile.c_str(), PIPELINE_CACHE_FILE.c_str()) != 0) {
+            std::cerr << "pipeline cache: failed to rename " << tmpFile << std::endl;
+            std::remove(tmpFile.c_str());
+        }
+    }
+
+    // 描述符集布局: binding 0 为顶点着色器使用的动态 uniform 缓冲, 实际偏移在绑定描述符集时指定
+    void createDescriptorSetLayout() {
+        VkDescriptorSetLayoutBinding uboLayoutBinding{};
+        uboLayoutBinding.binding = 0;
+        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        uboLayoutBinding.descriptorCount = 1;
+        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        uboLayoutBinding.pImmutableSamplers = nullptr;
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &uboLayoutBinding;
+
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+    }
 
+    // 创建图形管线
+    void createGraphicsPipeline() {
         // 创建 VkPipelineLayout 对象
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 0;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
         pipelineLayoutInfo.pushConstantRangeCount = 0;
 
-        // 创建管线对象
         if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create pipeline layout!");
         }
 
-        VkGraphicsPipelineCreateInfo pipelineInfo{};
-        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineInfo.stageCount = 2;
-        pipelineInfo.pStages = shaderStages;
-        pipelineInfo.pVertexInputState = &vertexInputInfo;
-        pipelineInfo.pInputAssemblyState = &inputAssembly;
-        pipelineInfo.pViewportState = &viewportState;
-        pipelineInfo.pRasterizationState = &rasterizer;
-        pipelineInfo.pMultisampleState = &multisampling;
-        pipelineInfo.pColorBlendState = &colorBlending;
-        pipelineInfo.layout = pipelineLayout;  // 指定之前创建的管线布局
-        pipelineInfo.renderPass = renderPass;  // 引用之前创建的渲染流程对象
-        pipelineInfo.subpass = 0;              // 子流程在子流程数组中的索引
-        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+        if (options.pipelineCacheReport) {
+            reportPipelineCacheTiming();
+        }
+        if (options.pipelineBuildReport) {
+            reportPipelineBuildTiming();
+        }
+
+        requestMaterialPipelines();
+    }
+
+    // 把所有材质的管线提交给编译服务, 只等待基础管线编译完成, 其它管线在绘制的同时继续编译。
+    //   状态相同的材质从注册表得到同一个管线; 重建渲染流程后再次请求时, 和旧渲染流程兼容的管线直接命中
+    void requestMaterialPipelines() {
+        retirePipelines(std::move(materialPipelines));
+        materialPipelines.clear();
+        materialPipelinesReady = false;
+
+        pipelineRequestTime = std::chrono::steady_clock::now();
+        for (uint32_t material = 0; material < options.materials; material++) {
+            materialPipelines.push_back(pipelineBuilder->request(materialPipelineDesc(material)));
+        }
+        pipelineBuilder->wait(materialPipelines[0]);
+
+        std::cout << "graphics pipeline created in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipelineRequestTime).count()
+                  << " ms (pipeline cache " << (pipelineCacheLoaded ? "warm" : "cold") << ")";
+        if (options.materials > 1) {
+            std::cout << ", " << pipelineBuilder->pendingCount() << " of " << options.materials << " material pipelines still compiling";
+        }
+        std::cout << std::endl;
+        pollMaterialPipelines();
+    }
+
+    // 每帧检查材质管线是否全部编译完成。完成时保存管线缓存, 并让静态场景重新录制 (之前录制的指令缓冲可能使用了退回的基础管线)
+    void pollMaterialPipelines() {
+        if (materialPipelinesReady || pipelineBuilder->pendingCount() > 0) {
+            return;
+        }
+        materialPipelinesReady = true;
+        if (options.materials == 1) {
+            return;
+        }
+
+        uint32_t failed = 0;
+        for (auto& pipeline : materialPipelines) {
+            failed += pipeline.failed() ? 1 : 0;
+        }
+        std::cout << "material pipelines: " << options.materials << " materials ready after "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipelineRequestTime).count()
+                  << " ms (" << pipelineBuilder->builtCount() << " unique pipelines, " << pipelineBuilder->totalBuildMs()
+                  << " ms of compile time on " << scheduler->threadSlotCount() << " threads)";
+        if (failed > 0) {
+            std::cout << ", " << failed << " failed and fall back to the base pipeline";
+        }
+        std::cout << std::endl;
+
+        savePipelineCache();
+        markSceneDirty();
+    }
+
+    // 把不再使用的管线交给 retiredPipelines。它们可能还被已经提交的帧使用, 被放弃的重载管线可能还在编译
+    void retirePipelines(std::vector<PipelineFuture> pipelines) {
+        if (!pipelines.empty()) {
+            retiredPipelines.push_back({graphicsTimeline->lastSubmitted(), std::move(pipelines)});
+        }
+    }
+
+    // 释放已经没有帧在使用的旧管线。又被当前的材质或进行中的重载用到的管线 (例如着色器改回了之前的内容, 注册表返回了同一个管线) 不释放
+    void releaseRetiredPipelines() {
+        auto inUse = [this](const PipelineFuture& pipeline) {
+            return std::find(materialPipelines.begin(), materialPipelines.end(), pipeline) != materialPipelines.end() ||
+                   std::find(reloadPipelines.begin(), reloadPipelines.end(), pipeline) != reloadPipelines.end();
+        };
+
+        while (!retiredPipelines.empty()) {
+            RetiredPipelines& retired = retiredPipelines.front();
+            if (!graphicsTimeline->isComplete(retired.value)) {
+                return;
+            }
+            // 还在编译的管线下一帧再检查, 不在这里等待编译
+            for (auto& pipeline : retired.pipelines) {
+                if (!pipeline.ready() && !pipeline.failed()) {
+                    return;
+                }
+            }
+            for (auto& pipeline : retired.pipelines) {
+                if (!inUse(pipeline)) {
+                    pipelineBuilder->release(pipeline);
+                }
+            }
+            retiredPipelines.pop_front();
+        }
+    }
+
+    // 用重载的字节码请求全部材质管线, 之前请求的重载管线被放弃
+    void requestReloadPipelines() {
+        retirePipelines(std::move(reloadPipelines));
+        reloadPipelines.clear();
+        for (uint32_t material = 0; material < options.materials; material++) {
+            reloadPipelines.push_back(pipelineBuilder->request(materialPipelineDesc(material, reloadVertShaderCode, reloadFragShaderCode)));
+        }
+    }
+
+    // 销毁已经没有剔除在使用的旧剔除管线
+    void releaseRetiredCullPipelines(bool wait) {
+        while (!retiredCullPipelines.empty()) {
+            RetiredComputePipeline& retired = retiredCullPipelines.front();
+            if (wait) {
+                computeTimeline->wait(retired.value);
+            } else if (!computeTimeline->isComplete(retired.value)) {
+                return;
+            }
+            vkDestroyPipeline(device, retired.pipeline, nullptr);
+            retiredCullPipelines.pop_front();
+        }
+    }
+
+    // 在帧之间处理着色器热重载: 取走重新编译好的着色器, 请求新管线 (在调度器上编译, 不阻塞绘制);
+    //   新管线全部就绪后一次性替换管线和字节码, 在此之前继续用旧管线绘制。编译失败时保留原来的着色器和管线
+    void pollShaderReload() {
+        if (!shaderWatcher) {
+            return;
+        }
+        releaseRetiredPipelines();
+        releaseRetiredCullPipelines(false);
+
+        for (ShaderReload& reload : shaderWatcher->poll()) {
+            if (!reload.ok) {
+                std::cerr << "shader reload: " << reload.name << " failed to compile, keeping the previous version\n" << reload.log << std::flush;
+                continue;
+            }
+            if (reload.name == "cull.comp") {
+                reloadCullPass(reload);
+                continue;
+            }
+            if (reloadPipelines.empty()) {
+                reloadVertShaderCode = vertShaderCode;
+                reloadFragShaderCode = fragShaderCode;
+                reloadChangedAt = reload.changedAt;
+            }
+            if (reload.name == "shader.vert") {
+                reloadVertShaderCode = reload.spirv;
+            } else {
+                reloadFragShaderCode = reload.spirv;
+            }
+            reloadCompileMs += reload.compileMs;
+
+            // 编译过程中又有修改时, 直接按最新的字节码重新请求
+            requestReloadPipelines();
+        }
+
+        if (reloadPipelines.empty()) {
+            return;
+        }
+        bool failed = false;
+        for (auto& pipeline : reloadPipelines) {
+            if (!pipeline.ready() && !pipeline.failed()) {
+                return;
+            }
+            failed = failed || pipeline.failed();
+        }
+
+        double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - reloadChangedAt).count();
+        if (failed) {
+            std::cerr << "shader reload: pipeline creation failed, keeping the previous pipelines" << std::endl;
+        } else {
+            vertShaderCode = reloadVertShaderCode;
+            fragShaderCode = reloadFragShaderCode;
+            materialPipelines.swap(reloadPipelines);
+            markSceneDirty();
+            std::cout << "shader reload: swapped in " << options.materials << " material pipelines " << totalMs
+                      << " ms after the change (glslc " << reloadCompileMs << " ms, pipelines " << totalMs - reloadCompileMs << " ms)" << std::endl;
+        }
+        retirePipelines(std::move(reloadPipelines));  // 替换后是旧管线, 失败时是这次重载的管线
+        reloadPipelines.clear();
+        reloadVertShaderCode = ShaderCode{};
+        reloadFragShaderCode = ShaderCode{};
+        reloadCompileMs = 0.0;
+    }
+
+    // 剔除着色器的热重载: 剔除的指令每帧重新录制, 替换后的下一帧就使用新管线; 旧管线只被计算队列上已经提交的剔除使用,
+    //   放进 retiredCullPipelines 等它们执行完再销毁, 不等待队列空闲 (描述符绑定改变时保留原来的管线)
+    void reloadCullPass(const ShaderReload& reload) {
+        if (!cullPass) {
+            return;
+        }
+        try {
+            VkPipeline previous = cullPass->reload(reload.spirv);
+            retiredCullPipelines.push_back({computeTimeline->lastSubmitted(), previous});
+            cullShaderCode = reload.spirv;
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - reload.changedAt).count();
+            std::cout << "shader reload: swapped in the culling pipeline " << ms << " ms after the change" << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "shader reload: " << e.what() << ", keeping the previous culling pipeline" << std::endl;
+        }
+    }
+
+    // 启动耗时报告: 用空的管线缓存, 分别在主线程上串行编译和通过编译服务并行编译整套材质管线, 对比耗时。
+    //   和 reportPipelineCacheTiming 一样, 测量前应关闭驱动自身的磁盘缓存
+    void reportPipelineBuildTiming() {
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+        std::vector<GraphicsPipelineDesc> descs;
+        for (uint32_t material = 0; material < options.materials; material++) {
+            descs.push_back(materialPipelineDesc(material));
+        }
+
+        // 串行编译使用一个没有工作线程的调度器, 所有编译都在等待的主线程上执行; 两次编译都经过注册表, 去重的结果相同
+        uint32_t uniquePipelines = 0;
+        auto timeBuild = [&](TaskScheduler& buildScheduler) {
+            VkPipelineCache cache;
+            if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create pipeline cache!");
+            }
+
+            double ms;
+            {
+                PipelineBuilder builder(device, buildScheduler, cache);
+                auto start = std::chrono::steady_clock::now();
+                for (auto& desc : descs) {
+                    builder.request(desc);
+                }
+                builder.waitAll();
+                ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                uniquePipelines = builder.builtCount();
+            }
+
+            vkDestroyPipelineCache(device, cache, nullptr);
+            return ms;
+        };
+
+        TaskScheduler serialScheduler(0);
+        double serialMs = timeBuild(serialScheduler);
+        double parallelMs = timeBuild(*scheduler);
+        std::cout << "pipeline build report (" << descs.size() << " materials, " << uniquePipelines << " unique pipelines):\n"
+                  << "  serial: " << serialMs << " ms\n"
+                  << "  parallel: " << parallelMs << " ms (" << scheduler->threadSlotCount() << " threads)\n"
+                  << "  speedup: " << serialMs / parallelMs << "x" << std::endl;
+    }
+
+    // 启动耗时报告: 用一个空的管线缓存 (cold) 和一个已包含该管线的缓存 (warm) 分别创建一次管线, 对比耗时。
+    //   注意驱动自身可能还有磁盘缓存 (如 Mesa 的 MESA_SHADER_CACHE_DISABLE), 测量 cold 时间前应关闭它。
+    void reportPipelineCacheTiming() {
+        auto timePipelineCreation = [this](VkPipelineCache cache) {
+            auto start = std::chrono::steady_clock::now();
+            VkPipeline pipeline = ::createGraphicsPipeline(device, materialPipelineDesc(0), cache);
+            auto end = std::chrono::steady_clock::now();
+            vkDestroyPipeline(device, pipeline, nullptr);
+            return std::chrono::duration<double, std::milli>(end - start).count();
+        };
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+        // cold: 空缓存, 创建后缓存中就有了该管线的数据
+        VkPipelineCache cache;
+        if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+        double coldMs = timePipelineCreation(cache);
+
+        // warm: 用 cold 阶段产生的缓存数据创建新的缓存对象, 模拟下次启动时从文件加载
+        size_t dataSize = 0;
+        vkGetPipelineCacheData(device, cache, &dataSize, nullptr);
+        std::vector<char> data(dataSize);
+        vkGetPipelineCacheData(device, cache, &dataSize, data.data());
+        vkDestroyPipelineCache(device, cache, nullptr);
+
+        cacheInfo.initialDataSize = dataSize;
+        cacheInfo.pInitialData = data.data();
+        if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+        double warmMs = timePipelineCreation(cache);
+        vkDestroyPipelineCache(device, cache, nullptr);
+
+        std::cout << "pipeline cache report:\n"
+                  << "  cold: " << coldMs << " ms\n"
+                  << "  warm: " << warmMs << " ms (" << dataSize << " bytes of cache data)\n"
+                  << "  speedup: " << coldMs / warmMs << "x" << std::endl;
+    }
+
+    // 映射构建时生成的着色器归档, 查找着色器字节码 (不访问 Vulkan 对象, 可以在任务中执行)。
+    //   归档由返回的 ShaderCode 持有, 不需要单独保存
+    void loadShaders() {
+        std::shared_ptr<ShaderArchive> archive = ShaderArchive::open(SHADER_ARCHIVE_FILE);
+        vertShaderCode = archive->find("shader.vert");
+        fragShaderCode = archive->find("shader.frag");
+        if (!vertShaderCode || !fragShaderCode) {
+            throw std::runtime_error("shader archive " + SHADER_ARCHIVE_FILE + " is missing shader.vert or shader.frag");
+        }
+        if (options.gpuCull) {
+            cullShaderCode = archive->find("cull.comp");
+            if (!cullShaderCode) {
+                throw std::runtime_error("shader archive " + SHADER_ARCHIVE_FILE + " is missing cull.comp");
+            }
+        }
+        declareShaderVariants();
+    }
+
+    // 声明着色器的特化常量 (必须和着色器源码中的 constant_id 一致), 并应用命令行的 --variant
+    void declareShaderVariants() {
+        auto variants = std::make_shared<ShaderVariants>();
+        variants->constant("TINT", 0, MATERIAL_TINT_BITS).toggle("GRAYSCALE", 1);
+        fragVariantKey = variants->defaultKey();
+        for (auto& [name, value] : options.shaderVariants) {
+            if (name == "TINT") {
+                throw std::runtime_error("--variant TINT is chosen per material (see --materials)");
+            }
+            fragVariantKey = variants->set(fragVariantKey, name, value);
+        }
+        fragVariants = variants;
+    }
+
+    // 材质 material 的管线描述。所有材质使用同一份着色器字节码, 只有片段着色器的变体不同:
+    //   材质 0 不着色, 其它材质的 TINT 特化常量选择各自的色调。变体键不同的材质各自是一个独立的管线
+    GraphicsPipelineDesc materialPipelineDesc(uint32_t material) {
+        return materialPipelineDesc(material, vertShaderCode, fragShaderCode);
+    }
+
+    GraphicsPipelineDesc materialPipelineDesc(uint32_t material, const ShaderCode& vertexShader, const ShaderCode& fragmentShader) {
+        GraphicsPipelineDesc desc;
+        desc.vertexShader = vertexShader;
+        desc.fragmentShader = fragmentShader;
+        desc.fragmentVariants = fragVariants;
+        desc.fragmentVariantKey = fragVariantKey;
+        desc.vertexBindings = {Vertex::getBindingDescription()};
+        auto attributeDescriptions = Vertex::getAttributeDescriptions();
+        desc.vertexAttributes.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+        desc.layout = pipelineLayout;
+        desc.renderPass = renderPass;
+
+        if (material > 0) {
+            // 限制了色调数时材质循环使用这些色调, 得到相同的变体键, 共用同一个管线
+            uint32_t tintCount = options.materialTints > 0 ? std::min(options.materialTints, MAX_MATERIAL_TINTS) : MAX_MATERIAL_TINTS;
+            uint32_t tint = (material - 1) % tintCount + 1;
+            desc.fragmentVariantKey = fragVariants->set(fragVariantKey, "TINT", tint);
+        }
+        return desc;
+    }
+
+    // 创建帧缓冲
+    void createFramebuffers() {
+        swapChainFramebuffers.resize(swapChainImageViews.size());
+
+        // 为交换链的每一个图像视图对象创建对应的帧缓冲
+        for (size_t i = 0; i < swapChainImageViews.size(); i++) {
+            swapChainFramebuffers[i] = createFramebuffer(swapChainImageViews[i], swapChainExtent);
+        }
+    }
+
+    // 创建以 imageView 为颜色附着的帧缓冲, 帧缓冲需要和渲染流程兼容
+    VkFramebuffer createFramebuffer(VkImageView imageView, VkExtent2D extent) {
+        VkImageView attachments[] = {
+            imageView
+        };
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = attachments;
+        framebufferInfo.width = extent.width;  // width 和 height 成员变量用于指定帧缓冲的大小
+        framebufferInfo.height = extent.height;
+        framebufferInfo.layers = 1;  // 指定图像层数
+
+        VkFramebuffer framebuffer;
+        if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create framebuffer!");
+        }
+        return framebuffer;
+    }
+
+    void createCommandPool() {
+        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create command pool!");
+        }
+
+        VkCommandPoolCreateInfo transferPoolInfo{};
+        transferPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        transferPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;  // 指令缓冲的生命周期很短
+        transferPoolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily.value_or(queueFamilyIndices.graphicsFamily.value());
+
+        if (vkCreateCommandPool(device, &transferPoolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create transfer command pool!");
+        }
+    }
+
+    // 创建缓冲并从分配器为它分配、绑定内存。
+    //   缓冲总是 EXCLUSIVE 模式 (CONCURRENT 模式可能让驱动放弃一些优化), 在队列族之间共享时用 queue_ownership.h 转移所有权
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                      VkBuffer& buffer, GpuAllocation& allocation) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        allocator->createBuffer(bufferInfo, properties, buffer, allocation);
+    }
+
+    // 创建顶点缓冲和索引缓冲并上传几何数据。
+    //   GPU 读取 DEVICE_LOCAL 内存最快, 但它通常不能被 CPU 映射, 所以先把数据写入一个主机可见的暂存缓冲,
+    //   再用一次提交中的两条拷贝指令 (批量拷贝) 复制到顶点缓冲和索引缓冲。存在专用传输队列时拷贝在传输队列上执行,
+    //   然后把缓冲的所有权转移给图形队列族: 图形队列上的获取提交等待传输时间线, 之后的绘制提交在同一个队列上, 自然排在它后面。
+    //   CPU 不等待上传完成, 暂存缓冲在上传完成后由 releaseGeometryUpload 释放。
+    void createGeometryBuffers() {
+        std::vector<Vertex> vertices = std::move(geometryVertices);
+        std::vector<uint32_t> indices = std::move(geometryIndices);
+        indexCount = static_cast<uint32_t>(indices.size());
+        buildDrawList();
+        if (options.gpuCull) {
+            buildCullDraws(vertices, indices);
+        }
+
+        VkDeviceSize vertexSize = sizeof(vertices[0]) * vertices.size();
+        VkDeviceSize indexSize = sizeof(indices[0]) * indices.size();
+
+        auto start = std::chrono::steady_clock::now();
+
+        // 顶点数据和索引数据放在同一个暂存缓冲中, 只需要分配和映射一次
+        VkBuffer& stagingBuffer = geometryStagingBuffer;
+        createBuffer(vertexSize + indexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     stagingBuffer, geometryStagingAllocation);
+
+        // 主机可见内存由分配器持久映射, 直接写入
+        char* data = static_cast<char*>(geometryStagingAllocation.mapped);
+        memcpy(data, vertices.data(), static_cast<size_t>(vertexSize));
+        memcpy(data + vertexSize, indices.data(), static_cast<size_t>(indexSize));
+
+        createBuffer(vertexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferAllocation);
+        createBuffer(indexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferAllocation);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = transferCommandPool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer& commandBuffer = geometryUploadCommandBuffer;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate transfer command buffer!");
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;  // 只提交一次
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        VkBufferCopy vertexCopy{0, 0, vertexSize};
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, vertexBuffer, 1, &vertexCopy);
+        VkBufferCopy indexCopy{vertexSize, 0, indexSize};
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, indexBuffer, 1, &indexCopy);
+
+        QueueFamilyIndices families = findQueueFamilies(physicalDevice);
+        uint32_t transferFamily = families.transferFamily.value_or(families.graphicsFamily.value());
+        BufferOwnershipTransfer transfers[2];
+        for (BufferOwnershipTransfer& transfer : transfers) {
+            transfer.srcQueueFamily = transferFamily;
+            transfer.dstQueueFamily = families.graphicsFamily.value();
+            transfer.srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            transfer.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            transfer.dstStageMask = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+        }
+        transfers[0].buffer = vertexBuffer;
+        transfers[0].dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+        transfers[1].buffer = indexBuffer;
+        transfers[1].dstAccessMask = VK_ACCESS_INDEX_READ_BIT;
+        recordRelease(commandBuffer, transfers, 2);
+
+        vkEndCommandBuffer(commandBuffer);
+
+        geometryUploadValue = transferTimeline->submit(&commandBuffer, 1);
+        if (needsAcquire(transfers, 2)) {
+            allocInfo.commandPool = commandPool;
+            if (vkAllocateCommandBuffers(device, &allocInfo, &geometryAcquireCommandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate command buffer!");
+            }
+            vkBeginCommandBuffer(geometryAcquireCommandBuffer, &beginInfo);
+            recordAcquire(geometryAcquireCommandBuffer, transfers, 2);
+            vkEndCommandBuffer(geometryAcquireCommandBuffer);
+
+            SemaphoreWait wait = transferTimeline->waitFor(geometryUploadValue, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+            geometryUploadValue = graphicsTimeline->submit(&geometryAcquireCommandBuffer, 1, &wait, 1);
+        }
+
+        if (options.triangles > 0) {
+            // 只有需要报告上传速度时才在 CPU 上等待上传完成
+            releaseGeometryUpload(true);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            double mb = (vertexSize + indexSize) / (1024.0 * 1024.0);
+            std::cout << "geometry: " << indexCount / 3 << " triangles, " << vertices.size() << " vertices, "
+                      << mb << " MB uploaded in " << ms << " ms (" << mb * 1000.0 / ms << " MB/s, "
+                      << (families.transferFamily.has_value() ? "transfer" : "graphics")
+                      << " queue)" << std::endl;
+        }
+    }
+
+    // 几何数据上传完成后释放暂存缓冲和上传用的指令缓冲。wait 为 false 时不阻塞, 上传还没完成则什么也不做
+    //   (获取提交等待了传输时间线, 图形时间线到达 geometryUploadValue 时两个队列上的提交都已经完成)
+    void releaseGeometryUpload(bool wait) {
+        if (geometryUploadValue == 0) {
+            return;
+        }
+        if (wait) {
+            graphicsTimeline->wait(geometryUploadValue);
+        } else if (!graphicsTimeline->isComplete(geometryUploadValue)) {
+            return;
+        }
+        vkFreeCommandBuffers(device, transferCommandPool, 1, &geometryUploadCommandBuffer);
+        if (geometryAcquireCommandBuffer != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(device, commandPool, 1, &geometryAcquireCommandBuffer);
+        }
+        allocator->destroyBuffer(geometryStagingBuffer, geometryStagingAllocation);
+        geometryUploadCommandBuffer = VK_NULL_HANDLE;
+        geometryAcquireCommandBuffer = VK_NULL_HANDLE;
+        geometryStagingBuffer = VK_NULL_HANDLE;
+        geometryUploadValue = 0;
+    }
+
+    // 创建每帧的 uniform 线性分配器, 以及指向它的描述符集。
+    //   描述符集只需要写入一次: 动态 uniform 缓冲描述符记录的是缓冲和每次读取的范围, 读取位置由绑定时的动态偏移决定
+    void createFrameArena() {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        frameArena.reset(new FrameArena(*allocator, static_cast<VkDeviceSize>(options.frameArenaKb) * 1024,
+                                        options.maxFramesInFlight, properties.limits.minUniformBufferOffsetAlignment,
+                                        sizeof(FrameUniforms)));
+
+        // 静态场景的指令缓冲会被反复提交, 它使用的数据不能随帧重置, 放在持久区域中
+        FrameUniforms* uniforms = frameArena->allocatePersistent<FrameUniforms>(staticUniformOffset);
+        uniforms->transform = glm::mat4(1.0f);
+
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        poolSize.descriptorCount = 1;
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = 1;
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &descriptorSetLayout;
+
+        if (vkAllocateDescriptorSets(device, &allocInfo, &frameDescriptorSet) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor set!");
+        }
+
+        VkDescriptorBufferInfo bufferInfo{};
+        bufferInfo.buffer = frameArena->buffer();
+        bufferInfo.offset = 0;
+        bufferInfo.range = sizeof(FrameUniforms);
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = frameDescriptorSet;
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &bufferInfo;
+
+        vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+    }
+
+    // 把索引缓冲拆分成 options.draws 次绘制。绘制次数多于三角形数时, 多出来的绘制重复绘制已有的三角形。
+    //   绘制按顺序均分给各个材质, 相同材质的绘制相邻, 录制时只在材质变化处切换管线
+    void buildDrawList() {
+        uint32_t triangleCount = indexCount / 3;
+        drawList.clear();
+        drawList.reserve(options.draws);
+        for (uint32_t i = 0; i < options.draws; i++) {
+            uint32_t material = static_cast<uint32_t>(static_cast<uint64_t>(options.materials) * i / options.draws);
+            if (options.draws <= triangleCount) {
+                uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(triangleCount) * i / options.draws);
+                uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(triangleCount) * (i + 1) / options.draws);
+                drawList.push_back({first * 3, (last - first) * 3, material});
+            } else {
+                drawList.push_back({(i % triangleCount) * 3, 3, material});
+            }
+        }
+    }
+
+    // 计算每次绘制的包围圆 (绘制的所有顶点的包围盒的外接圆), 供 GPU 剔除使用
+    void buildCullDraws(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+        cullDraws.clear();
+        cullDraws.reserve(drawList.size());
+        for (const DrawItem& draw : drawList) {
+            glm::vec2 lo(std::numeric_limits<float>::max());
+            glm::vec2 hi(-std::numeric_limits<float>::max());
+            for (uint32_t i = draw.firstIndex; i < draw.firstIndex + draw.indexCount; i++) {
+                lo = glm::min(lo, vertices[indices[i]].pos);
+                hi = glm::max(hi, vertices[indices[i]].pos);
+            }
+            CullDraw cull{};
+            cull.firstIndex = draw.firstIndex;
+            cull.indexCount = draw.indexCount;
+            cull.center = (lo + hi) * 0.5f;
+            cull.radius = glm::length(hi - lo) * 0.5f;
+            cullDraws.push_back(cull);
+        }
+    }
+
+    // 创建 GPU 剔除的计算管线 (描述符集布局从 cull.comp 反射得到)、每个 in-flight 帧的间接绘制缓冲和描述符集,
+    //   以及计算队列族的指令池
+    void createCullPass() {
+        if (!options.gpuCull) {
+            return;
+        }
+        cullPass.reset(new ComputePass(device, cullShaderCode, pipelineCache));
+
+        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily.value_or(queueFamilyIndices.graphicsFamily.value());
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &computeCommandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute command pool!");
+        }
+
+        // 包围圆只在计算着色器中读取, 数据很小, 直接放在主机可见内存中
+        VkDeviceSize drawBytes = sizeof(CullDraw) * std::max<size_t>(cullDraws.size(), 1);
+        createBuffer(drawBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     cullDrawBuffer, cullDrawAllocation);
+        memcpy(cullDrawAllocation.mapped, cullDraws.data(), sizeof(CullDraw) * cullDraws.size());
+
+        std::vector<VkDescriptorPoolSize> poolSizes = cullPass->poolSizes(options.maxFramesInFlight);
+        VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+        descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        descriptorPoolInfo.pPoolSizes = poolSizes.data();
+        descriptorPoolInfo.maxSets = options.maxFramesInFlight;
+        if (vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &cullDescriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create culling descriptor pool!");
+        }
+
+        cullFrames.resize(options.maxFramesInFlight);
+        for (CullFrame& frame : cullFrames) {
+            VkDeviceSize commandBytes = sizeof(VkDrawIndexedIndirectCommand) * std::max<size_t>(drawList.size(), 1);
+            createBuffer(commandBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.commands, frame.commandsAllocation);
+            createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.stats, frame.statsAllocation);
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = computeCommandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(device, &allocInfo, &frame.commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate compute command buffer!");
+            }
+
+            VkDescriptorSetLayout setLayout = cullPass->setLayout();
+            VkDescriptorSetAllocateInfo setInfo{};
+            setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            setInfo.descriptorPool = cullDescriptorPool;
+            setInfo.descriptorSetCount = 1;
+            setInfo.pSetLayouts = &setLayout;
+            if (vkAllocateDescriptorSets(device, &setInfo, &frame.descriptorSet) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate culling descriptor set!");
+            }
+            cullPass->writeBuffer(frame.descriptorSet, 0, cullDrawBuffer);
+            cullPass->writeBuffer(frame.descriptorSet, 1, frame.commands);
+            cullPass->writeBuffer(frame.descriptorSet, 2, frame.stats);
+        }
+
+        std::cout << "gpu culling: " << drawList.size() << " draws, workgroup size " << cullPass->reflection().localSize[0] << ", "
+                  << (computeTimeline != graphicsTimeline.get() ? "async compute queue" : "graphics queue") << ", "
+                  << (multiDrawIndirect ? "multi-draw indirect (up to " + std::to_string(maxDrawIndirectCount) + " per call)"
+                                        : std::string("one indirect draw per item")) << std::endl;
+    }
+
+    // 指令缓冲区从计算队列族转移到图形队列族 (队列族相同时是计算写入到间接绘制读取的普通屏障)
+    BufferOwnershipTransfer cullCommandsTransfer(uint32_t frame) {
+        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+        BufferOwnershipTransfer transfer;
+        transfer.buffer = cullFrames[frame].commands;
+        transfer.srcQueueFamily = queueFamilyIndices.computeFamily.value_or(queueFamilyIndices.graphicsFamily.value());
+        transfer.dstQueueFamily = queueFamilyIndices.graphicsFamily.value();
+        transfer.srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        transfer.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        transfer.dstStageMask = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+        transfer.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        return transfer;
+    }
+
+    // 录制并提交这一帧的剔除, 返回绘制提交需要等待的计算时间线值。
+    //   上一次使用这一帧的指令缓冲区的绘制已经执行完毕 (drawFrame 开始时等待过), 计算着色器直接覆盖其中的内容,
+    //   不需要把所有权从图形队列族转移回来
+    uint64_t submitCull(uint32_t frame) {
+        TRACE_SCOPE("recordCull");
+        CullFrame& cull = cullFrames[frame];
+        VkCommandBuffer commandBuffer = cull.commandBuffer;
+        vkResetCommandBuffer(commandBuffer, 0);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording compute command buffer!");
+        }
+
+        // 清零可见绘制数, 计算着色器用原子加法累加
+        vkCmdFillBuffer(commandBuffer, cull.stats, 0, sizeof(uint32_t), 0);
+        VkMemoryBarrier clearBarrier{};
+        clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0,
+                             nullptr, 0, nullptr);
+
+        CullParams params{};
+        params.transform = frameTransform();
+        params.drawCount = static_cast<uint32_t>(drawList.size());
+        cullPass->bind(commandBuffer, cull.descriptorSet);
+        cullPass->pushConstants(commandBuffer, &params, sizeof(params));
+        cullPass->dispatch(commandBuffer, params.drawCount);
+
+        // 指令交给图形队列的间接绘制, 统计交给主机
+        BufferOwnershipTransfer transfer = cullCommandsTransfer(frame);
+        recordRelease(commandBuffer, &transfer, 1);
+        VkMemoryBarrier hostBarrier{};
+        hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        hostBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr,
+                             0, nullptr);
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record compute command buffer!");
+        }
+
+        cull.value = computeTimeline->submit(&commandBuffer, 1);
+        cull.pending = true;
+        return cull.value;
+    }
 
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create graphics pipeline!");
+    // 读取一帧的剔除统计 (调用前该帧的提交必须已经执行完毕)
+    void collectCullStats(uint32_t frame) {
+        if (frame >= cullFrames.size() || !cullFrames[frame].pending) {
+            return;
         }
+        cullVisibleDraws += *static_cast<const uint32_t*>(cullFrames[frame].statsAllocation.mapped);
+        cullFrameCount++;
+        cullFrames[frame].pending = false;
+    }
 
-        // 注意，着色器模块对象只在管线创建时需要，用完了可以销毁
-        vkDestroyShaderModule(device, fragShaderModule, nullptr);
-        vkDestroyShaderModule(device, vertShaderModule, nullptr);
+    void destroyCullPass() {
+        if (!cullPass) {
+            return;
+        }
+        releaseRetiredCullPipelines(true);
+        for (CullFrame& frame : cullFrames) {
+            allocator->destroyBuffer(frame.commands, frame.commandsAllocation);
+            allocator->destroyBuffer(frame.stats, frame.statsAllocation);
+        }
+        allocator->destroyBuffer(cullDrawBuffer, cullDrawAllocation);
+        vkDestroyDescriptorPool(device, cullDescriptorPool, nullptr);  // 描述符集随描述符池一起释放
+        vkDestroyCommandPool(device, computeCommandPool, nullptr);
+        cullPass.reset();
     }
 
-    // 创建帧缓冲
-    void createFramebuffers() {
-        swapChainFramebuffers.resize(swapChainImageViews.size());
+    // 为调度器的每个线程槽位在每个 in-flight 帧创建一个指令池 (辅助指令缓冲在录制时按需分配)
+    void createRecordCommandPools() {
+        activeRecordThreads = options.recordThreads;
+        if (options.recordThreads == 0 && options.recordBenchmark == 0) {
+            return;
+        }
 
-        // 为交换链的每一个图像视图对象创建对应的帧缓冲
-        for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-            VkImageView attachments[] = {
-                swapChainImageViews[i]
-            };
+        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
 
-            VkFramebufferCreateInfo framebufferInfo{};
-            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            framebufferInfo.renderPass = renderPass;
-            framebufferInfo.attachmentCount = 1;
-            framebufferInfo.pAttachments = attachments;
-            framebufferInfo.width = swapChainExtent.width;  // width 和 height 成员变量用于指定帧缓冲的大小
-            framebufferInfo.height = swapChainExtent.height;
-            framebufferInfo.layers = 1;  // 指定图像层数
+        recordSlotFrames.resize(scheduler->threadSlotCount());
+        for (auto& slotFrames : recordSlotFrames) {
+            slotFrames.resize(options.maxFramesInFlight);
+            for (auto& slotFrame : slotFrames) {
+                VkCommandPoolCreateInfo poolInfo{};
+                poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;  // 每帧整体重置, 不需要单独重置指令缓冲
+                poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+                if (vkCreateCommandPool(device, &poolInfo, nullptr, &slotFrame.commandPool) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create record command pool!");
+                }
+            }
+        }
+    }
 
-            if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create framebuffer!");
+    // 从当前线程槽位的指令池取一个辅助指令缓冲, 不够时再分配 (只有该槽位的线程会访问这个指令池)
+    VkCommandBuffer acquireSecondaryCommandBuffer(RecordSlotFrame& slotFrame) {
+        if (slotFrame.usedCount == slotFrame.secondaryCommandBuffers.size()) {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = slotFrame.commandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 1;
+
+            VkCommandBuffer commandBuffer;
+            if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate secondary command buffer!");
             }
+            slotFrame.secondaryCommandBuffers.push_back(commandBuffer);
         }
+        return slotFrame.secondaryCommandBuffers[slotFrame.usedCount++];
     }
 
-    void createCommandPool() {
-        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+    // 为每个 in-flight 帧分配一个指令缓冲
+    void createCommandBuffers() {
+        commandBuffers.resize(options.maxFramesInFlight);
 
-        VkCommandPoolCreateInfo poolInfo{};
-        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
 
-        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create command pool!");
+        if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+
+        if (options.staticScene) {
+            allocateSceneCommandBuffers();
         }
     }
 
-    void createCommandBuffer() {
+    // 静态场景模式下, 为每个交换链帧缓冲额外分配一个指令缓冲, 第一次使用时录制
+    void allocateSceneCommandBuffers() {
+        sceneCommandBuffers.resize(swapChainFramebuffers.size());
+        sceneCommandBufferDirty.assign(swapChainFramebuffers.size(), true);
+
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.commandPool = commandPool;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = 1;
+        allocInfo.commandBufferCount = static_cast<uint32_t>(sceneCommandBuffers.size());
 
-        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        if (vkAllocateCommandBuffers(device, &allocInfo, sceneCommandBuffers.data()) != VK_SUCCESS) {
             throw std::runtime_error("failed to allocate command buffers!");
         }
     }
 
-    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    // 录制绘制指令, readbackBuffer 不为空时在渲染流程结束后把图像拷贝到该缓冲
+    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkBuffer readbackBuffer = VK_NULL_HANDLE) {
+        TRACE_SCOPE("recordCommandBuffer");
+        auto start = std::chrono::steady_clock::now();
+
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
@@ -600,82 +2394,531 @@ private:
         if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
             throw std::runtime_error("failed to begin recording command buffer!");
         }
+        if (gpuProfiler) {
+            gpuProfiler->beginFrame(commandBuffer, currentFrame);
+        }
+        if (cullPass) {
+            // 获取计算队列剔除得到的间接绘制指令 (队列族相同时不需要)
+            BufferOwnershipTransfer transfer = cullCommandsTransfer(currentFrame);
+            recordAcquire(commandBuffer, &transfer, 1);
+        }
+
+        // 额外的渲染目标使用同一个管线, 只是帧缓冲和视口不同 (无窗口模式下 imageIndex 就是 in-flight 帧的索引)
+        std::vector<RenderPassTarget> passes;
+        passes.push_back({swapChainFramebuffers[imageIndex], swapChainExtent, frameUniformOffset()});
+        for (const auto& target : extraTargets) {
+            passes.push_back({target.framebuffers[imageIndex], target.extent, frameUniformOffset()});
+        }
+
+        if (activeRecordThreads > 0) {
+            recordRenderPassesParallel(commandBuffer, passes);
+        } else {
+            for (size_t p = 0; p < passes.size(); p++) {
+                uint32_t scope = beginGpuScope(commandBuffer, p);
+                recordRenderPass(commandBuffer, passes[p]);
+                endGpuScope(commandBuffer, scope);
+            }
+        }
+
+        if (readbackBuffer != VK_NULL_HANDLE) {
+            uint32_t scope = gpuProfiler ? gpuProfiler->beginScope(commandBuffer, "readback") : 0;
+            recordReadback(commandBuffer, imageIndex, readbackBuffer);
+            endGpuScope(commandBuffer, scope);
+        }
+
+        if (gpuProfiler) {
+            gpuProfiler->endFrame(commandBuffer);
+        }
+        // 结束指令缓冲的记录操作
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+
+        recordMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        recordCount++;
+    }
+
+    // 为一次绘制准备 uniform 数据, 返回它在 frameArena 中的偏移。
+    //   静态场景使用持久区域中固定的数据; 否则每次从当前帧的区域分配, 场景随帧数旋转
+    uint32_t frameUniformOffset() {
+        if (options.staticScene) {
+            return staticUniformOffset;
+        }
 
+        uint32_t offset;
+        FrameUniforms* uniforms = frameArena->allocate<FrameUniforms>(offset);
+        uniforms->transform = frameTransform();
+        return offset;
+    }
+
+    // 当前帧的场景变换 (随帧数旋转), GPU 剔除使用同一个变换
+    glm::mat4 frameTransform() const {
+        return glm::rotate(glm::mat4(1.0f), frameCount * glm::radians(0.5f), glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+
+    void beginRenderPass(VkCommandBuffer commandBuffer, const RenderPassTarget& pass, VkSubpassContents contents) {
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
         renderPassInfo.renderPass = renderPass;
-        renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+        renderPassInfo.framebuffer = pass.framebuffer;
         renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = swapChainExtent;
+        renderPassInfo.renderArea.extent = pass.extent;
 
         VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
         renderPassInfo.clearValueCount = 1;
         renderPassInfo.pClearValues = &clearColor;
 
         // 开始一个渲染流程 (注：所有可以记录指令到指令缓冲的函数的函数名都带有一个 vkCmd 前缀)
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-            // 绑定图形管线
-            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-            // 绘制
-            vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+        //   contents 为 SECONDARY_COMMAND_BUFFERS 时, 渲染流程中的指令全部来自辅助指令缓冲
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+    }
+
+    // 在主指令缓冲中直接录制一次完整的渲染流程: 在 pass.framebuffer 上以 pass.extent 大小的视口绘制整个绘制列表。
+    //   视口和裁剪是动态状态, 所以同一个管线可以用于任意分辨率的帧缓冲 (只要帧缓冲和渲染流程兼容)。
+    void recordRenderPass(VkCommandBuffer commandBuffer, const RenderPassTarget& pass) {
+        beginRenderPass(commandBuffer, pass, VK_SUBPASS_CONTENTS_INLINE);
+            recordDraws(commandBuffer, pass, 0, drawList.size());
         // 结束渲染流程
         vkCmdEndRenderPass(commandBuffer);
+    }
 
-        // 结束指令缓冲的记录操作
-        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to record command buffer!");
+    // 多线程录制: 把绘制列表拆分成 activeRecordThreads 段, 每段作为一个任务提交给调度器, 录制到辅助指令缓冲 (每个渲染流程一个),
+    //   主指令缓冲只负责开始/结束渲染流程, 并通过 vkCmdExecuteCommands 按绘制列表的顺序执行这些辅助指令缓冲。
+    //   指令池不能被多个线程同时使用, 所以任务从执行它的线程槽位自己的指令池分配; 每个 in-flight 帧一组指令池, 帧的提交执行完毕后整体重置。
+    void recordRenderPassesParallel(VkCommandBuffer commandBuffer, const std::vector<RenderPassTarget>& passes) {
+        uint32_t jobs = static_cast<uint32_t>(std::min<size_t>(activeRecordThreads, drawList.size()));
+        uint32_t frame = currentFrame;
+
+        // 此时没有任务在使用这一帧的指令池
+        for (auto& slotFrames : recordSlotFrames) {
+            vkResetCommandPool(device, slotFrames[frame].commandPool, 0);
+            slotFrames[frame].usedCount = 0;
+        }
+
+        std::vector<VkCommandBuffer> secondaries(static_cast<size_t>(jobs) * passes.size());  // [渲染流程][任务]
+        TaskCounter recorded;
+        for (uint32_t job = 0; job < jobs; job++) {
+            scheduler->submit([this, job, jobs, frame, &passes, &secondaries] {
+                RecordSlotFrame& slotFrame = recordSlotFrames[scheduler->threadSlot()][frame];
+
+                size_t first = drawList.size() * job / jobs;
+                size_t last = drawList.size() * (job + 1) / jobs;
+
+                for (size_t p = 0; p < passes.size(); p++) {
+                    // 辅助指令缓冲在渲染流程内执行, 需要指定它继承的渲染流程和帧缓冲
+                    VkCommandBufferInheritanceInfo inheritanceInfo{};
+                    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+                    inheritanceInfo.renderPass = renderPass;
+                    inheritanceInfo.subpass = 0;
+                    inheritanceInfo.framebuffer = passes[p].framebuffer;
+
+                    VkCommandBufferBeginInfo beginInfo{};
+                    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+                    VkCommandBuffer secondary = acquireSecondaryCommandBuffer(slotFrame);
+                    if (vkBeginCommandBuffer(secondary, &beginInfo) != VK_SUCCESS) {
+                        throw std::runtime_error("failed to begin recording secondary command buffer!");
+                    }
+                    recordDraws(secondary, passes[p], first, last);
+                    if (vkEndCommandBuffer(secondary) != VK_SUCCESS) {
+                        throw std::runtime_error("failed to record secondary command buffer!");
+                    }
+                    secondaries[p * jobs + job] = secondary;
+                }
+            }, &recorded);
+        }
+        scheduler->wait(recorded);
+
+        for (size_t p = 0; p < passes.size(); p++) {
+            uint32_t scope = beginGpuScope(commandBuffer, p);
+            beginRenderPass(commandBuffer, passes[p], VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            vkCmdExecuteCommands(commandBuffer, jobs, &secondaries[p * jobs]);
+            vkCmdEndRenderPass(commandBuffer);
+            endGpuScope(commandBuffer, scope);
+        }
+    }
+
+    // 渲染流程 pass 的 GPU 计时范围 (时间戳只能在主指令缓冲的渲染流程之外写入)。没有开启 GPU 计时时什么也不做
+    uint32_t beginGpuScope(VkCommandBuffer commandBuffer, size_t pass) {
+        return gpuProfiler ? gpuProfiler->beginScope(commandBuffer, passScopeNames[pass]) : 0;
+    }
+
+    void endGpuScope(VkCommandBuffer commandBuffer, uint32_t scope) {
+        if (gpuProfiler) {
+            gpuProfiler->endScope(commandBuffer, scope);
+        }
+    }
+
+    // 录制绘制列表中 [first, last) 范围内的绘制。辅助指令缓冲不继承主指令缓冲的状态, 所以管线、视口等都要重新设置
+    void recordDraws(VkCommandBuffer commandBuffer, const RenderPassTarget& pass, size_t first, size_t last) {
+        // 设置动态的视口和裁剪。需要注意,交换链图像的大小可能与窗口大小不同, 这里使用帧缓冲的大小
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = (float) pass.extent.width;
+        viewport.height = (float) pass.extent.height;
+        viewport.minDepth = 0.0f;  // 指定帧缓冲使用的深度值的范围
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor{};
+        scissor.offset = {0, 0};
+        scissor.extent = pass.extent; // 在整个帧缓冲上进行绘制操作,所以将裁剪范围设置为和帧缓冲大小一样
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        // 绑定顶点缓冲和索引缓冲
+        VkBuffer vertexBuffers[] = {vertexBuffer};
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+        // 绑定描述符集, 动态偏移指定这次绘制读取的 FrameUniforms
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameDescriptorSet, 1, &pass.uniformOffset);
+
+        // 绘制, 材质变化时切换图形管线。材质的管线还没编译好时退回到基础管线, 基础管线也没有时跳过这次绘制
+        VkPipeline fallbackPipeline = materialPipelines[0].get();
+        VkPipeline boundPipeline = VK_NULL_HANDLE;
+        for (size_t i = first; i < last; ) {
+            VkPipeline pipeline = materialPipelines[drawList[i].material].get();
+            if (pipeline == VK_NULL_HANDLE) {
+                pipeline = fallbackPipeline;
+                if (pipeline == VK_NULL_HANDLE) {
+                    i++;
+                    continue;
+                }
+            }
+            if (pipeline != boundPipeline) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                boundPipeline = pipeline;
+            }
+            if (!cullPass) {
+                vkCmdDrawIndexed(commandBuffer, drawList[i].indexCount, 1, drawList[i].firstIndex, 0, 0);
+                i++;
+                continue;
+            }
+
+            // GPU 剔除: 指令缓冲区和绘制列表一一对应, 同一材质的一段连续绘制用一次间接绘制调用提交 (被剔除的绘制实例数为 0)。
+            //   每次调用的指令数不能超过 maxDrawIndirectCount, 更长的一段拆成多次调用
+            size_t end = i + 1;
+            while (end < last && end - i < maxDrawIndirectCount && drawList[end].material == drawList[i].material) {
+                end++;
+            }
+            const VkDeviceSize stride = sizeof(VkDrawIndexedIndirectCommand);
+            vkCmdDrawIndexedIndirect(commandBuffer, cullFrames[currentFrame].commands, i * stride, static_cast<uint32_t>(end - i), stride);
+            i = end;
+        }
+    }
+
+    // 拷贝离屏图像到暂存缓冲 (图像已经由渲染流程转换为 TRANSFER_SRC_OPTIMAL 布局)
+    void recordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkBuffer readbackBuffer) {
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;   // 0 表示像素紧密排列
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {swapChainExtent.width, swapChainExtent.height, 1};
+
+        vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region);
+
+        // 让拷贝写入的数据对主机可见 (时间线信号量本身只保证设备端的执行完成)
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = readbackBuffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                             0, nullptr, 1, &barrier, 0, nullptr);
+    }
+
+    // 创建回读用的暂存缓冲环 (持久映射), 并启动编码线程
+    void createReadbackBuffers() {
+        if (options.dumpDir.empty()) {
+            return;
+        }
+
+        std::filesystem::create_directories(options.dumpDir);
+
+        uint32_t count = options.maxFramesInFlight + READBACK_BUFFERS_PER_ENCODER * options.dumpThreads;
+        VkDeviceSize size = static_cast<VkDeviceSize>(swapChainExtent.width) * swapChainExtent.height * 4;  // RGBA8
+
+        readbackBuffers = std::vector<ReadbackBuffer>(count);
+        for (auto& readback : readbackBuffers) {
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = size;
+            bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            // 优先使用 HOST_CACHED 内存, CPU 读取未缓存的内存非常慢
+            try {
+                allocator->createBuffer(bufferInfo,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                    readback.buffer, readback.allocation);
+            } catch (const std::runtime_error&) {
+                allocator->createBuffer(bufferInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                    readback.buffer, readback.allocation);
+            }
+            readback.mapped = readback.allocation.mapped;
+        }
+
+        frameReadbackBuffers.assign(options.maxFramesInFlight, -1);
+        frameReadbackIndices.assign(options.maxFramesInFlight, 0);
+        frameEncoder.reset(new FrameEncoder(options.dumpDir, options.dumpFormat, options.dumpThreads));
+    }
+
+    // 获取一个空闲的暂存缓冲, 没有时返回 -1 (不等待编码线程)
+    int acquireReadbackBuffer() {
+        for (size_t i = 0; i < readbackBuffers.size(); i++) {
+            if (readbackBuffers[i].available.load(std::memory_order_acquire)) {
+                readbackBuffers[i].available.store(false, std::memory_order_relaxed);
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    // 设备空闲时把所有 in-flight 帧还没交出的回读交给编码线程。改变 in-flight 帧数前必须调用, 否则超出新帧数的槽位永远不会被收取
+    void drainReadback() {
+        if (!frameEncoder) {
+            return;
+        }
+        for (uint32_t i = 0; i < frameReadbackBuffers.size(); i++) {
+            collectReadback(i);
+        }
+    }
+
+    // 绘制循环结束后调用 (设备已空闲): 交出最后几帧, 等待编码结束并打印回读统计。start 是该循环开始的时间
+    void finishReadback(std::chrono::steady_clock::time_point start) {
+        if (!frameEncoder) {
+            return;
         }
+        drainReadback();
+        frameEncoder->finish();
+
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        uint64_t captured = frameEncoder->encodedFrames();
+        std::cout << "readback: " << captured << " frames captured (" << captured * 1000.0 / ms << " fps), "
+                  << readbackDropped << " dropped, " << frameEncoder->failedFrames() << " failed, rendered "
+                  << frameCount << " frames" << std::endl;
+    }
+
+    // 该 in-flight 帧上一次提交的指令已经执行完毕, 把它回读的数据交给编码线程
+    void collectReadback(uint32_t frame) {
+        int index = frameReadbackBuffers[frame];
+        if (index < 0) {
+            return;
+        }
+        frameReadbackBuffers[frame] = -1;
+
+        ReadbackBuffer& readback = readbackBuffers[index];
+        frameEncoder->submit(readback.mapped, swapChainExtent.width, swapChainExtent.height, frameReadbackIndices[frame],
+                             [&readback] { readback.available.store(true, std::memory_order_release); });
     }
 
     void createSyncObjects() {
+        imageAvailableSemaphores.resize(options.maxFramesInFlight);
+        frameTimelineValues.assign(options.maxFramesInFlight, 0);  // 时间线的值从 1 开始, 第一次等待 0 时不会阻塞
+        imageTimelineValues.assign(swapChainImages.size(), 0);     // 初始时没有帧使用交换链图像
+        framesInFlight = options.maxFramesInFlight;
+
+        // 帧的完成由图形队列的时间线信号量表示, 这里只创建交换链的获取和呈现需要的二值信号量
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        for (uint32_t i = 0; i < options.maxFramesInFlight; i++) {
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create synchronization objects for a frame!");
+            }
+        }
+        createRenderFinishedSemaphores();
+    }
+
+    // 每张交换链图像一个呈现等待的信号量
+    void createRenderFinishedSemaphores() {
+        if (options.headless) {
+            return;
+        }
         VkSemaphoreCreateInfo semaphoreInfo{};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkFenceCreateInfo fenceInfo{};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        renderFinishedSemaphores.resize(swapChainImages.size());
+        for (auto& semaphore : renderFinishedSemaphores) {
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create synchronization objects for a swap chain image!");
+            }
+        }
+    }
+
+    void destroyRenderFinishedSemaphores() {
+        for (VkSemaphore semaphore : renderFinishedSemaphores) {
+            vkDestroySemaphore(device, semaphore, nullptr);
+        }
+        renderFinishedSemaphores.clear();
+    }
+
+    // 创建 GPU 计时器 (每个 in-flight 帧一个查询池), 并为每个渲染流程生成计时范围名
+    void createGpuProfiler() {
+        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        gpuProfiler.reset(new GpuProfiler(physicalDevice, device, indices.graphicsFamily.value(), options.maxFramesInFlight));
+        frameSubmitTicks.assign(options.maxFramesInFlight, 0);
 
-        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS ||
-            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS ||
-            vkCreateFence(device, &fenceInfo, nullptr, &inFlightFence) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create synchronization objects for a frame!");
+        passScopeNames = {"main pass"};
+        for (const auto& target : extraTargets) {
+            passScopeNames.push_back("extra pass " + std::to_string(target.extent.width) + "x" + std::to_string(target.extent.height));
         }
+        gpuSummaryTime = std::chrono::steady_clock::now();
     }
 
-    void drawFrame() {
-        vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);  // CPU阻塞等待GPU结束执行上一次提交到的指令
-        vkResetFences(device, 1, &inFlightFence);  // 将fence对象转到unsignaled状态。
+    // 绘制一帧, 返回这一帧是否被呈现 (无窗口模式下是否已经提交)。交换链过期而重建时跳过这一帧, 返回 false
+    bool drawFrame() {
+        TRACE_SCOPE("drawFrame");
+
+        // CPU阻塞等待GPU结束执行该帧位置上一次提交的指令 (其它帧位置的指令仍可以在GPU上继续执行)
+        {
+            TRACE_SCOPE("waitForFrame");
+            graphicsTimeline->wait(frameTimelineValues[currentFrame]);
+        }
+        releaseGeometryUpload(false);
+        collectCullStats(currentFrame);  // 该帧位置上一次的剔除在绘制之前执行, 也已经完成
+
+        // 该帧位置上一次提交的指令已经执行完毕, 它的 uniform 数据区域可以整体重置, 时间戳查询的结果也可以直接读回
+        frameArena->beginFrame(currentFrame);
+        if (gpuProfiler) {
+            gpuProfiler->collect(currentFrame);
+            // GPU 范围以提交这一帧的时间为起点放进 CPU 时间线 (GPU 不会在提交之前开始执行, 实际开始时间可能更晚)
+            if (CpuTrace::enabled()) {
+                for (const GpuScopeTiming& timing : gpuProfiler->lastFrame()) {
+                    CpuTrace::addGpuEvent(gpuProfiler->scopeName(timing.scope), frameSubmitTicks[currentFrame], timing.beginMs * 1000.0,
+                                          (timing.endMs - timing.beginMs) * 1000.0);
+                }
+            }
+        }
+
+        {
+            TRACE_SCOPE("pollPipelines");
+            // 没有工作线程时后台编译只能在这里推进, 每帧一个任务 (编译完所有管线之前每帧会多一次编译的耗时)
+            scheduler->runPending();
+            pollMaterialPipelines();
+            pollShaderReload();
+        }
 
-        // 从交换链获取一张图像 (此处不会阻塞CPU，获取成功后会通知信号量imageAvailableSemaphore)
         uint32_t imageIndex;
-        vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex); // UINT64_MAX 表示禁用图像获取超时
+        if (options.headless) {
+            imageIndex = currentFrame;  // 无窗口模式下每个 in-flight 帧固定使用自己的离屏图像
+        } else {
+            // 从交换链获取一张图像 (此处不会阻塞CPU，获取成功后会通知信号量imageAvailableSemaphore)
+            VkResult result;
+            {
+                TRACE_SCOPE("acquireImage");
+                result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex); // UINT64_MAX 表示禁用图像获取超时
+            }
+
+            // 交换链已经和表面不匹配 (通常是窗口尺寸改变), 无法再使用, 重建后跳过这一帧。
+            // 这一帧没有提交, 该帧位置的时间线值不变, 下一次等待立即返回。
+            // VK_SUBOPTIMAL_KHR 表示交换链仍然可用, 只是不再完全匹配, 继续绘制, 在呈现之后再重建。
+            if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+                recreateSwapChain();
+                return false;
+            } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                throw std::runtime_error("failed to acquire swap chain image!");
+            }
+        }
+
+        // 获取到的图像可能仍在被之前的某一帧使用 (交换链图像数和 in-flight 帧数不一致, 或者图像返回顺序不固定时), 需要等待那一帧结束
+        if (!graphicsTimeline->isComplete(imageTimelineValues[imageIndex])) {
+            TRACE_SCOPE("waitForImage");
+            graphicsTimeline->wait(imageTimelineValues[imageIndex]);
+        }
 
-        vkResetCommandBuffer(commandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
-        recordCommandBuffer(commandBuffer, imageIndex);
+        // 该帧位置上一次的回读已经完成, 交给编码线程; 然后为这一帧挑选一个空闲的暂存缓冲
+        VkBuffer readbackBuffer = VK_NULL_HANDLE;
+        if (frameEncoder) {
+            collectReadback(currentFrame);
+
+            int index = acquireReadbackBuffer();
+            if (index >= 0) {
+                frameReadbackBuffers[currentFrame] = index;
+                frameReadbackIndices[currentFrame] = frameCount;
+                readbackBuffer = readbackBuffers[index].buffer;
+            } else {
+                readbackDropped++;
+            }
+        }
 
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        // 先提交剔除, 计算队列可以在录制绘制指令的同时开始执行
+        uint64_t cullValue = cullPass ? submitCull(currentFrame) : 0;
+
+        VkCommandBuffer commandBuffer;
+        if (options.staticScene) {
+            // 该图像对应的指令缓冲只会和该图像一起提交, 上面已经等待了上一次使用该图像的提交, 所以此时它不在执行中, 可以安全地重新录制
+            commandBuffer = sceneCommandBuffers[imageIndex];
+            if (sceneCommandBufferDirty[imageIndex]) {
+                vkResetCommandBuffer(commandBuffer, 0);
+                recordCommandBuffer(commandBuffer, imageIndex);
+                sceneCommandBufferDirty[imageIndex] = false;
+                sceneRecordCount++;
+            }
+        } else {
+            commandBuffer = commandBuffers[currentFrame];
+            vkResetCommandBuffer(commandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
+            recordCommandBuffer(commandBuffer, imageIndex, readbackBuffer);
+        }
 
         // 指定队列开始执行前需要等待的信号量,以及需要等待的管线阶段。
-        VkSemaphore waitSemaphores[] = {imageAvailableSemaphore};
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
+        //   交换链图像获取完成后才能写入颜色附件 (无窗口模式下没有图像获取操作, 不需要等待);
+        //   几何数据的上传不需要等待: 它的最后一次提交 (所有权获取) 在同一个图形队列上, 已经排在这一帧之前;
+        //   剔除在专用计算队列上执行时, 间接绘制阶段等待计算时间线 (在图形队列上执行时同样已经排在前面)
+        SemaphoreWait waits[2];
+        uint32_t waitCount = 0;
+        if (!options.headless) {
+            waits[waitCount++] = {imageAvailableSemaphores[currentFrame], 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+        }
+        if (cullValue != 0 && computeTimeline != graphicsTimeline.get()) {
+            waits[waitCount++] = computeTimeline->waitFor(cullValue, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+        }
 
-        // 指定实际被提交执行的指令缓冲对象。
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
+        // 指令缓冲执行结束后图形时间线到达这一帧的值, 同时通知呈现操作 (无窗口模式下没有呈现操作, 不需要通知)
+        VkSemaphore renderFinished = options.headless ? VK_NULL_HANDLE : renderFinishedSemaphores[imageIndex];
+        {
+            TRACE_SCOPE("queueSubmit");
+            if (!frameSubmitTicks.empty()) {
+                frameSubmitTicks[currentFrame] = CpuTrace::now();
+            }
+            uint64_t value = graphicsTimeline->submit(&commandBuffer, 1, waits, waitCount, renderFinished);
+            frameTimelineValues[currentFrame] = value;
+            imageTimelineValues[imageIndex] = value;  // 标记该图像被当前帧使用
+        }
 
-        // 指定在指令缓冲执行结束后发出信号的信号量对象
-        VkSemaphore signalSemaphores[] = {renderFinishedSemaphore};
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;
+        currentFrame = (currentFrame + 1) % framesInFlight;
+        frameCount++;
 
-        // vkQueueSubmit可以同时大批量提交数据
-        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence) != VK_SUCCESS) {
-            throw std::runtime_error("failed to submit draw command buffer!");
+        if (options.headless) {
+            return true;
+        }
+        // VK_SUBOPTIMAL_KHR 时图像仍然被呈现了, VK_ERROR_OUT_OF_DATE_KHR 时没有
+        VkResult result = present(imageIndex, renderFinished);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
+            recreateSwapChain();
+        } else if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to present swap chain image!");
         }
+        return result != VK_ERROR_OUT_OF_DATE_KHR;
+    }
+
+    // 将绘制完成的交换链图像提交呈现, 呈现操作会等待 waitSemaphore (绘制完成) 后开始
+    VkResult present(uint32_t imageIndex, VkSemaphore waitSemaphore) {
+        VkSemaphore signalSemaphores[] = {waitSemaphore};
 
         VkPresentInfoKHR presentInfo{};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -690,23 +2933,277 @@ private:
         presentInfo.pImageIndices = &imageIndex; // 指定需要呈现的图像在交换链中的索引
 
         // 请求交换链进行图像呈现操作
-        vkQueuePresentKHR(presentQueue, &presentInfo);
+        TRACE_SCOPE("queuePresent");
+        return vkQueuePresentKHR(presentQueue, &presentInfo);
+    }
+
+    bool isWindowClosed() {
+        return !options.headless && glfwWindowShouldClose(window);
+    }
+
+    void pollEvents() {
+        if (!options.headless) {
+            glfwPollEvents();
+        }
+    }
+
+    // 主循环的一帧: 限速, 采样输入, 绘制, 然后记录这一帧的帧间隔和延迟
+    void pacedFrame() {
+        framePacer.waitForNextFrame();
+        auto inputTime = std::chrono::steady_clock::now();
+        if (!options.headless) {
+            TRACE_SCOPE("pollEvents");
+            glfwPollEvents();
+        }
+        // 交换链重建时没有呈现, 不计入帧间隔和延迟
+        if (drawFrame()) {
+            framePacer.framePresented(inputTime);
+        }
+    }
+
+    void printFramePacing(const std::string& mode, const FramePacingStats& pacing) {
+        std::cout << "frame pacing (" << mode << ", " << swapChainImages.size() << " images";
+        if (options.targetFps > 0) {
+            std::cout << ", target " << options.targetFps << " fps, " << pacing.missedFrames << " missed";
+        }
+        std::cout << "): " << pacing.frames << " frames, mean " << pacing.meanMs << " ms, p50 " << pacing.p50Ms << " ms, p99 "
+                  << pacing.p99Ms << " ms, max " << pacing.maxMs << " ms, jitter " << pacing.jitterMs << " ms, input-to-present p50 "
+                  << pacing.latencyP50Ms << " ms, p99 " << pacing.latencyP99Ms << " ms" << std::endl;
+    }
+
+    // 呈现模式对比: 依次切换到每种支持的呈现模式 (重建交换链), 预热后各绘制 pacingCompare 帧, 输出帧节奏统计。
+    //   例如 ./tri --pacing-compare 600 --swapchain-images 3 --pacing-csv pacing.csv
+    void runPacingComparison() {
+        SwapChainSupportDetails support = querySwapChainSupport(physicalDevice);
+        const VkPresentModeKHR modes[] = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR,
+                                          VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+        for (VkPresentModeKHR mode : modes) {
+            if (isWindowClosed()) {
+                break;
+            }
+            if (std::find(support.presentModes.begin(), support.presentModes.end(), mode) == support.presentModes.end()) {
+                std::cout << "frame pacing (" << presentModeName(mode) << "): not supported" << std::endl;
+                continue;
+            }
+            requestedPresentMode = mode;
+            recreateSwapChain();
+
+            for (uint32_t i = 0; i < framesInFlight * 2 && !isWindowClosed(); i++) {
+                pollEvents();
+                drawFrame();
+            }
+            framePacer.reset();
+            for (uint32_t i = 0; i < options.pacingCompare && !isWindowClosed(); i++) {
+                pacedFrame();
+            }
+            vkDeviceWaitIdle(device);
+
+            FramePacingStats pacing = framePacer.stats();
+            printFramePacing(presentModeName(mode), pacing);
+            if (!options.pacingCsv.empty()) {
+                appendFramePacingCsv(options.pacingCsv, presentModeName(mode), static_cast<uint32_t>(swapChainImages.size()),
+                                     options.targetFps, pacing);
+            }
+        }
+        requestedPresentMode = options.presentMode;
+    }
+
+    // 窗口尺寸压力测试: 每帧把窗口改成一个新的尺寸, 共 resizeStorm 次, 统计每次交换链重建造成的停顿
+    void runResizeStorm() {
+        const int sizes[][2] = {{800, 600}, {640, 480}, {1024, 768}, {320, 240}, {1280, 720}, {500, 700}};
+        const size_t sizeCount = sizeof(sizes) / sizeof(sizes[0]);
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < options.resizeStorm && !glfwWindowShouldClose(window); i++) {
+            glfwSetWindowSize(window, sizes[i % sizeCount][0], sizes[i % sizeCount][1]);
+            glfwPollEvents();
+            drawFrame();
+        }
+        vkDeviceWaitIdle(device);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "resize storm: " << options.resizeStorm << " resize requests, " << frameCount << " frames in " << ms << " ms" << std::endl;
+    }
+
+    // 以指定的 in-flight 帧数连续绘制 frameCount 帧, 返回平均每帧耗时 (毫秒)
+    double measureFrameTime(uint32_t inFlight, uint32_t frameCount) {
+        vkDeviceWaitIdle(device);  // 切换配置前等待所有帧结束, 此时所有帧的时间线值都已经到达
+        drainReadback();
+        framesInFlight = inFlight;
+        currentFrame = 0;
+
+        // 预热几帧, 排除首次提交的额外开销
+        for (uint32_t i = 0; i < inFlight * 2 && !isWindowClosed(); i++) {
+            pollEvents();
+            drawFrame();
+        }
+        vkDeviceWaitIdle(device);
+
+        auto start = std::chrono::steady_clock::now();
+        uint32_t drawn = 0;
+        for (; drawn < frameCount && !isWindowClosed(); drawn++) {
+            pollEvents();
+            drawFrame();
+        }
+        vkDeviceWaitIdle(device);  // 计入最后几帧在GPU上的执行时间
+        auto end = std::chrono::steady_clock::now();
+
+        if (drawn == 0) {
+            throw std::runtime_error("benchmark aborted: window closed");
+        }
+        return std::chrono::duration<double, std::milli>(end - start).count() / drawn;
+    }
+
+    // 帧时间测试: 分别以 1 帧和 maxFramesInFlight 帧并行绘制, 对比吞吐量。
+    //   可以通过环境变量 VK_ICD_FILENAMES 指定软件实现 (如 lavapipe) 来测试:
+    //   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ./tri --benchmark 500
+    void runBenchmark() {
+        auto start = std::chrono::steady_clock::now();
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+        double serialMs = measureFrameTime(1, options.benchmarkFrames);
+        double pipelinedMs = measureFrameTime(options.maxFramesInFlight, options.benchmarkFrames);
+
+        std::cout << "benchmark device: " << deviceProperties.deviceName << "\n"
+                  << "  frames in flight = 1: " << serialMs << " ms/frame, " << 1000.0 / serialMs << " fps\n"
+                  << "  frames in flight = " << options.maxFramesInFlight << ": " << pipelinedMs << " ms/frame, "
+                  << 1000.0 / pipelinedMs << " fps\n"
+                  << "  throughput gain: " << serialMs / pipelinedMs << "x\n"
+                  << "  triangles per frame: " << indexCount / 3 << ", " << (indexCount / 3) / (pipelinedMs * 1000.0) << " Mtri/s" << std::endl;
+
+        framesInFlight = options.maxFramesInFlight;
+        currentFrame = 0;
+        finishReadback(start);
     }
 
-    // 创建着色器模块对象
-    VkShaderModule createShaderModule(const std::vector<char>& code) {
-        VkShaderModuleCreateInfo createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    // 录制测试: 分别在主线程直接录制, 以及把录制拆分成 1, 2, 4 ... 个并行任务 (最多为调度器的线程数), 对比每帧的录制耗时。
+    //   例如 ./tri --headless --triangles 100000 --draws 100000 --record-benchmark 100
+    void runRecordBenchmark() {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<uint32_t> threadCounts = {0};
+        for (uint32_t t = 1; t < scheduler->threadSlotCount(); t *= 2) {
+            threadCounts.push_back(t);
+        }
+        threadCounts.push_back(scheduler->threadSlotCount());
+
+        std::cout << "record benchmark: " << drawList.size() << " draws, " << options.recordBenchmark << " frames per configuration" << std::endl;
+
+        double inlineMs = 0.0;
+        for (uint32_t threads : threadCounts) {
+            vkDeviceWaitIdle(device);
+            activeRecordThreads = threads;
+
+            // 预热, 让指令池分配好内存
+            for (uint32_t i = 0; i < options.maxFramesInFlight * 2 && !isWindowClosed(); i++) {
+                pollEvents();
+                drawFrame();
+            }
+            vkDeviceWaitIdle(device);
+
+            recordMs = 0.0;
+            recordCount = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < options.recordBenchmark && !isWindowClosed(); i++) {
+                pollEvents();
+                drawFrame();
+            }
+            vkDeviceWaitIdle(device);
+            double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            if (recordCount == 0) {
+                throw std::runtime_error("benchmark aborted: window closed");
+            }
+            double avgRecordMs = recordMs / recordCount;
+            if (threads == 0) {
+                inlineMs = avgRecordMs;
+            }
+            std::cout << "  " << (threads == 0 ? std::string("inline") : std::to_string(threads) + " jobs") << ": record "
+                      << avgRecordMs << " ms/frame (" << inlineMs / avgRecordMs << "x), frame " << frameMs / recordCount << " ms" << std::endl;
+        }
+
+        activeRecordThreads = options.recordThreads;
+        finishReadback(start);
+    }
 
-        VkShaderModule shaderModule;
-        if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create shader module!");
+    // 着色器加载测试: 在构建目录下生成 N 个着色器模块的 .spv 文件 (内容轮流取自 shader.vert / shader.frag) 和包含它们的归档,
+    //   测量加载全部 N 个模块 (读取字节码 + vkCreateShaderModule) 的耗时:
+    //     files:   逐个 readFile, 每个文件一次打开、读取和分配
+    //     archive: 映射一个归档, 字节码指针直接传给 vkCreateShaderModule
+    //   cold 之前用 posix_fadvise(POSIX_FADV_DONTNEED) 把文件移出页缓存 (不需要 root 权限), warm 是紧接着的第二次加载。
+    void runShaderLoadBenchmark() {
+        const uint32_t count = options.shaderLoadBenchmark;
+        std::string dir = TEST_BIN_PATH "shader_load_benchmark/";
+        std::filesystem::create_directories(dir);
+
+        std::vector<std::string> names;
+        std::vector<std::string> paths;
+        std::vector<std::pair<std::string, std::vector<char>>> archiveInputs;
+        for (uint32_t i = 0; i < count; i++) {
+            const ShaderCode& source = i % 2 == 0 ? vertShaderCode : fragShaderCode;
+            std::vector<char> spirv(reinterpret_cast<const char*>(source.code), reinterpret_cast<const char*>(source.code) + source.size);
+            names.push_back("shader" + std::to_string(i) + (i % 2 == 0 ? ".vert" : ".frag"));
+            paths.push_back(dir + names.back() + ".spv");
+            std::ofstream file(paths.back(), std::ios::binary | std::ios::trunc);
+            file.write(spirv.data(), spirv.size());
+            archiveInputs.emplace_back(names.back(), std::move(spirv));
         }
-        // 调用vkCreateShaderModule 函数后,code不再需要了，我们就可以立即释放掉存储着色器字节码的数组code内存
+        std::string archivePath = dir + "benchmark.spvpack";
+        writeShaderArchive(archivePath, std::move(archiveInputs));
+
+        // 刚写入的页是脏页, 先同步到磁盘才能被丢弃
+        auto dropFromPageCache = [](const std::string& path) {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd >= 0) {
+                fdatasync(fd);
+                posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+                close(fd);
+            }
+        };
 
-        return shaderModule;
+        std::vector<VkShaderModule> modules(count);
+        auto destroyModules = [&]() {
+            for (VkShaderModule module : modules) {
+                vkDestroyShaderModule(device, module, nullptr);
+            }
+        };
+        auto loadFiles = [&]() {
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < count; i++) {
+                std::vector<char> code = readFile(paths[i]);
+                modules[i] = createShaderModule(device, reinterpret_cast<const uint32_t*>(code.data()), code.size());
+            }
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            destroyModules();
+            return ms;
+        };
+        auto loadArchive = [&]() {
+            auto start = std::chrono::steady_clock::now();
+            std::shared_ptr<ShaderArchive> archive = ShaderArchive::open(archivePath);
+            for (uint32_t i = 0; i < count; i++) {
+                ShaderCode code = archive->find(names[i]);
+                modules[i] = createShaderModule(device, code.code, code.size);
+            }
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            destroyModules();
+            return ms;
+        };
+
+        for (const std::string& path : paths) {
+            dropFromPageCache(path);
+        }
+        double filesColdMs = loadFiles();
+        double filesWarmMs = loadFiles();
+        dropFromPageCache(archivePath);
+        double archiveColdMs = loadArchive();
+        double archiveWarmMs = loadArchive();
+
+        std::filesystem::remove_all(dir);
+
+        std::cout << "shader load benchmark: " << count << " shader modules\n"
+                  << "  files:   cold " << filesColdMs << " ms, warm " << filesWarmMs << " ms\n"
+                  << "  archive: cold " << archiveColdMs << " ms (" << filesColdMs / archiveColdMs << "x), warm "
+                  << archiveWarmMs << " ms (" << filesWarmMs / archiveWarmMs << "x)" << std::endl;
     }
 
     // 选择最佳表面格式
@@ -722,6 +3219,14 @@ private:
 
     // 选择最佳呈现模式
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
+        if (requestedPresentMode) {
+            if (std::find(availablePresentModes.begin(), availablePresentModes.end(), *requestedPresentMode) != availablePresentModes.end()) {
+                return *requestedPresentMode;
+            }
+            std::cerr << "present mode " << presentModeName(*requestedPresentMode) << " is not supported, using fifo" << std::endl;
+            return VK_PRESENT_MODE_FIFO_KHR;
+        }
+
         for (const auto& availablePresentMode : availablePresentModes) {
             if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
                 return availablePresentMode;
@@ -755,6 +3260,10 @@ private:
     }
 
     void createSurface() {
+        if (options.headless) {
+            return;  // 无窗口模式不需要表面
+        }
+
         // 我们可以使用 GLFW 库的 glfwCreateWin-dowSurface 函数来完成表面创建, 它在不同平台的实现是不同的, 可以跨平台使用。
         // GLFW并没有提供清除表面的函数，需要我们自己调用 vkDestroySurfaceKHR 接口.
         if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
@@ -823,13 +3332,30 @@ private:
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
         // 检测交换链的能力是否满足需求，需要至少支持：一种图像格式、一种支持我们的窗口表面的呈现模式
-        bool swapChainAdequate = false;
-        if (extensionsSupported) {
+        bool swapChainAdequate = options.headless;  // 无窗口模式下不使用交换链
+        if (extensionsSupported && !options.headless) {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
         }
 
-        return indices.isComplete() && extensionsSupported && swapChainAdequate;
+        return indices.isComplete() && extensionsSupported && swapChainAdequate && checkTimelineSemaphoreSupport(device);
+    }
+
+    // 帧和上传的同步使用时间线信号量, 需要设备支持 Vulkan 1.2 并且启用 timelineSemaphore 特性
+    bool checkTimelineSemaphoreSupport(VkPhysicalDevice device) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+        if (properties.apiVersion < VK_API_VERSION_1_2) {
+            return false;
+        }
+
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &vulkan12Features;
+        vkGetPhysicalDeviceFeatures2(device, &features);
+        return vulkan12Features.timelineSemaphore == VK_TRUE;
     }
 
     bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
@@ -840,7 +3366,8 @@ private:
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
         // 将所需的扩展保存在一个集合中,然后枚举所有可用的扩展,将集合中的扩展剔除,最后,如果这个集合中的元素为 0,说明我们所需的扩展全部都被满足。
-        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        auto extensions = getDeviceExtensions();
+        std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
         for (const auto& extension : availableExtensions) {
             requiredExtensions.erase(extension.extensionName);
@@ -849,6 +3376,14 @@ private:
         return requiredExtensions.empty();
     }
 
+    // 获取需要启用的设备扩展 (无窗口模式下不需要交换链扩展)
+    std::vector<const char*> getDeviceExtensions() {
+        if (options.headless) {
+            return {};
+        }
+        return deviceExtensions;
+    }
+
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device) {
         QueueFamilyIndices indices;
 
@@ -861,20 +3396,36 @@ private:
         int i = 0;
         for (const auto& queueFamily : queueFamilies) {
             // 检查队列族是否具有图形能力(绘制能力)
-            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily.has_value()) {
                 indices.graphicsFamily = i;
             }
 
+            // 只支持传输 (不支持图形和计算) 的队列族一般对应独立的 DMA 引擎, 拷贝可以和绘制并行执行
+            if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && !indices.transferFamily.has_value()) {
+                indices.transferFamily = i;
+            }
+
+            // 支持计算但不支持图形的队列族可以和绘制并行执行计算 (异步计算)
+            if ((queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+                !indices.computeFamily.has_value()) {
+                indices.computeFamily = i;
+            }
+
             // 检查物理设备的队列族是否具有呈现能力
             // ( 绘制指令队列族和呈现队列族可以是同一个队列族，也可能不是同一个 )
+            // 无窗口模式下没有表面, 不会进行呈现操作, 直接使用图形队列族
+            // 有窗口时呈现队列族必须是真正支持呈现的族 i; 若图形队列族本身支持呈现则优先选它, 省去跨队列族的所有权转移
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-            if (presentSupport) {
-                indices.presentFamily = i;
-            }
-
-            if (indices.isComplete()) {
-                break;
+            if (options.headless) {
+                if (indices.graphicsFamily.has_value()) {
+                    indices.presentFamily = indices.graphicsFamily;
+                }
+            } else {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+                if (presentSupport && (!indices.presentFamily.has_value() || indices.graphicsFamily == static_cast<uint32_t>(i))) {
+                    indices.presentFamily = i;
+                }
             }
 
             i++;
@@ -970,10 +3521,13 @@ private:
         }
 
         // Vulkan 是平台无关的 API,所以需要和窗口系统交互的扩展。 GLFW 库包含了一个可以返回这一扩展的函数
-        uint32_t glfwExtensionCount = 0;
-        const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        // (无窗口模式下不和窗口系统交互, 不需要这些扩展)
+        std::vector<const char*> extensions;
+        if (!options.headless) {
+            uint32_t glfwExtensionCount = 0;
+            const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
         // 仅仅启用校验层并没有任何用处,我们不能得到任何有用的调试信息。为了获得调试信息,我们需要使用 VK_EXT_debug_utils 扩展,设置回调函数来接受调试信息。
         if (enableValidationLayers) {
@@ -1034,11 +3588,25 @@ private:
     }
 };
 
-int main() {
-    HelloTriangleApplication app;
-
+int main(int argc, char* argv[]) {
     try {
+        AppOptions options = parseOptions(argc, argv);
+        if (options.schedulerBenchmark > 0) {
+            runTaskSchedulerBenchmark(options.schedulerBenchmark, std::cout);
+            return EXIT_SUCCESS;
+        }
+        if (!options.cpuTraceFile.empty()) {
+            CpuTrace::start();
+            TRACE_THREAD_NAME("main");
+        }
+        HelloTriangleApplication app(options);
         app.run();
+        if (!options.cpuTraceFile.empty()) {
+            uint64_t dropped = 0;
+            uint64_t events = CpuTrace::write(options.cpuTraceFile, &dropped);
+            std::cout << "cpu trace: " << events << " events written to " << options.cpuTraceFile << " (" << dropped
+                      << " overwritten in full ring buffers)" << std::endl;
+        }
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
         return EXIT_FAILURE;